@@ -0,0 +1,262 @@
+/* Frame Capture */
+
+/*
+ * Captured frames are read back into a small pool of buffers on the render thread and handed to an
+ * encoder thread, which writes them out while the next frames render. When every buffer is queued or
+ * being written the frame is dropped and counted rather than waited for, so capturing never holds up
+ * the loop. Frames go out as a directory of PPMs, or as a stream file where each frame is stored as
+ * runs of the bytes that changed since the last one, a fraction of the size for mostly still footage.
+ */
+#define CAPTURE_BUFFERS 4 /* Pool size, also the deepest the queue gets */
+#define CAPTURE_MIN_SKIP 8 /* Unchanged bytes it takes to end a literal run */
+#define CAPTURE_STREAM_MAGIC "RRCV"
+#define CAPTURE_STREAM_VERSION 1
+#define CAPTURE_STREAM_SUFFIX ".rrcv"
+
+typedef struct frame_capture {
+    char path[256]; /* Directory of PPMs, or a stream file ending in CAPTURE_STREAM_SUFFIX */
+    FILE* stream; /* NULL when writing PPMs */
+    int width;
+    int height;
+    Uint8* buffers[CAPTURE_BUFFERS];
+    int frame_numbers[CAPTURE_BUFFERS];
+    int free_buffers[CAPTURE_BUFFERS];
+    int num_free;
+    int queue[CAPTURE_BUFFERS]; /* Filled buffers in frame order */
+    int queue_head;
+    int queue_len;
+    Uint8* previous; /* Encoder's last frame, streams store the change from it */
+    Uint8* changes;
+
+    SDL_mutex* lock; /* Guards the free list, the queue and the encoder's counters */
+    SDL_cond* queued;
+    SDL_Thread* thread; /* NULL while not capturing */
+    int stopping;
+
+    int frames; /* Offered, including the dropped ones */
+    int dropped;
+    int written;
+    int failed; /* Writes that failed, the frame is lost but capturing goes on */
+    long long bytes;
+    Uint64 read_time; /* Performance counter ticks on the render thread */
+    Uint64 encode_time;
+} frame_capture;
+
+int capture_is_stream(const char* path) {
+    int len = strlen(path), suffix = strlen(CAPTURE_STREAM_SUFFIX);
+    return len > suffix && strcmp(path + len - suffix, CAPTURE_STREAM_SUFFIX) == 0;
+}
+
+/* Stream Encoding */
+void capture_write_stream_frame(frame_capture* cap, const Uint8* pixels, int frame) {
+    int size = cap->width * cap->height * 3;
+    for (int i = 0; i < size; i++) cap->changes[i] = pixels[i] ^ cap->previous[i];
+    memcpy(cap->previous, pixels, size);
+
+    /* Alternating runs, unchanged bytes to skip then changed bytes to XOR in, until the frame is covered */
+    replay_put_varint(cap->stream, frame);
+    for (int i = 0; i < size;) {
+        int skip = 0;
+        while (i + skip < size && !cap->changes[i + skip]) skip++;
+        i += skip;
+        int literal = 0;
+        while (i + literal < size) {
+            int zeros = 0;
+            while (zeros < CAPTURE_MIN_SKIP && i + literal + zeros < size && !cap->changes[i + literal + zeros]) zeros++;
+            if (zeros == CAPTURE_MIN_SKIP || i + literal + zeros == size) break;
+            literal += zeros ? zeros : 1;
+        }
+        replay_put_varint(cap->stream, skip);
+        replay_put_varint(cap->stream, literal);
+        fwrite(&cap->changes[i], 1, literal, cap->stream);
+        i += literal;
+    }
+}
+
+/* Encoder Thread */
+void capture_encode(frame_capture* cap, int b) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    int ok = TRUE;
+    long long bytes;
+
+    if (cap->stream) {
+        long before = ftell(cap->stream);
+        capture_write_stream_frame(cap, cap->buffers[b], cap->frame_numbers[b]);
+        ok = !ferror(cap->stream);
+        bytes = ftell(cap->stream) - before;
+    } else {
+        char path[300];
+        snprintf(path, sizeof(path), "%s/frame_%06d.ppm", cap->path, cap->frame_numbers[b]);
+        ok = write_ppm(path, cap->buffers[b], cap->width, cap->height);
+        bytes = (long long) cap->width * cap->height * 3;
+    }
+
+    SDL_LockMutex(cap->lock);
+    if (ok) {
+        cap->written++;
+        cap->bytes += bytes;
+    } else cap->failed++;
+    cap->encode_time += SDL_GetPerformanceCounter() - start;
+    SDL_UnlockMutex(cap->lock);
+}
+
+/* Writes queued frames until stopped, then finishes the queue */
+int capture_thread(void* data) {
+    frame_capture* cap = data;
+    SDL_LockMutex(cap->lock);
+    while (TRUE) {
+        while (!cap->queue_len && !cap->stopping) SDL_CondWait(cap->queued, cap->lock);
+        if (!cap->queue_len) break;
+        int b = cap->queue[cap->queue_head];
+        cap->queue_head = (cap->queue_head + 1) % CAPTURE_BUFFERS;
+        cap->queue_len--;
+        SDL_UnlockMutex(cap->lock);
+
+        capture_encode(cap, b);
+
+        SDL_LockMutex(cap->lock);
+        cap->free_buffers[cap->num_free++] = b;
+    }
+    SDL_UnlockMutex(cap->lock);
+    return 0;
+}
+
+/* Capturing */
+
+/* Releases the buffers, stream and thread objects, the counters stay for a last report */
+void capture_free(frame_capture* cap) {
+    for (int i = 0; i < CAPTURE_BUFFERS; i++) free(cap->buffers[i]);
+    memset(cap->buffers, 0, sizeof(cap->buffers));
+    free(cap->previous);
+    free(cap->changes);
+    cap->previous = NULL;
+    cap->changes = NULL;
+    if (cap->stream) fclose(cap->stream);
+    cap->stream = NULL;
+    if (cap->queued) SDL_DestroyCond(cap->queued);
+    if (cap->lock) SDL_DestroyMutex(cap->lock);
+    cap->queued = NULL;
+    cap->lock = NULL;
+}
+
+int capture_start(frame_capture* cap, const char* path, int width, int height) {
+    int size = width * height * 3;
+    memset(cap, 0, sizeof(*cap));
+    snprintf(cap->path, sizeof(cap->path), "%s", path);
+    cap->width = width;
+    cap->height = height;
+
+    if (capture_is_stream(path)) {
+        cap->stream = fopen(path, "wb");
+        cap->previous = calloc(size, 1);
+        cap->changes = malloc(size);
+        if (!cap->stream || !cap->previous || !cap->changes) {
+            capture_free(cap);
+            return FALSE;
+        }
+        fwrite(CAPTURE_STREAM_MAGIC, 1, 4, cap->stream);
+        fputc(CAPTURE_STREAM_VERSION, cap->stream);
+        replay_put_varint(cap->stream, width);
+        replay_put_varint(cap->stream, height);
+    }
+    for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+        cap->buffers[i] = malloc(size);
+        cap->free_buffers[cap->num_free++] = i;
+        if (!cap->buffers[i]) {
+            capture_free(cap);
+            return FALSE;
+        }
+    }
+    cap->lock = SDL_CreateMutex();
+    cap->queued = SDL_CreateCond();
+    if (cap->lock && cap->queued) cap->thread = SDL_CreateThread(capture_thread, "capture encoder", cap);
+    if (!cap->thread) {
+        capture_free(cap);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Render side, reads the finished frame into a free buffer and queues it, or drops it when none is free */
+void capture_frame(frame_capture* cap, SDL_Renderer* renderer) {
+    int frame = cap->frames++;
+    SDL_LockMutex(cap->lock);
+    int b = cap->num_free ? cap->free_buffers[--cap->num_free] : -1;
+    SDL_UnlockMutex(cap->lock);
+    if (b < 0) {
+        cap->dropped++;
+        return;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    int ok = SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_RGB24, cap->buffers[b], cap->width * 3) == 0;
+    cap->read_time += SDL_GetPerformanceCounter() - start;
+    cap->frame_numbers[b] = frame;
+
+    SDL_LockMutex(cap->lock);
+    if (ok) {
+        cap->queue[(cap->queue_head + cap->queue_len) % CAPTURE_BUFFERS] = b;
+        cap->queue_len++;
+        SDL_CondSignal(cap->queued);
+    } else {
+        cap->free_buffers[cap->num_free++] = b;
+        cap->failed++;
+    }
+    SDL_UnlockMutex(cap->lock);
+}
+
+/* Waits for the queued frames to be written */
+void capture_stop(frame_capture* cap) {
+    if (!cap->thread) return;
+    SDL_LockMutex(cap->lock);
+    cap->stopping = TRUE;
+    SDL_CondSignal(cap->queued);
+    SDL_UnlockMutex(cap->lock);
+    SDL_WaitThread(cap->thread, NULL);
+    cap->thread = NULL;
+    capture_free(cap);
+}
+
+/* Stream Decoding */
+
+/* Writes every frame of a stream file to DIR as PPMs, returns the frames written or -1 */
+int capture_unpack(const char* path, const char* dir) {
+    char magic[4];
+    Uint32 width, height, frame, skip, literal;
+    int frames = 0;
+    FILE* f = fopen(path, "rb");
+    if (!f) return -1;
+    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, CAPTURE_STREAM_MAGIC, 4) != 0 || fgetc(f) != CAPTURE_STREAM_VERSION ||
+        !replay_get_varint(f, &width) || !replay_get_varint(f, &height) || (Uint64) width * height == 0 || (Uint64) width * height > (1 << 26)) { /* In 64 bits, Uint32 products wrap */
+        fclose(f);
+        return -1;
+    }
+    Uint32 size = width * height * 3;
+    Uint8* pixels = calloc(size, 1);
+
+    while (replay_get_varint(f, &frame)) {
+        for (Uint32 i = 0; i < size;) {
+            if (!replay_get_varint(f, &skip) || !replay_get_varint(f, &literal) || skip > size - i || literal > size - i - skip) {
+                frames = -1;
+                break;
+            }
+            i += skip;
+            for (Uint32 end = i + literal; i < end; i++) {
+                int c = fgetc(f);
+                if (c == EOF) break;
+                pixels[i] ^= c;
+            }
+        }
+        if (frames < 0) break;
+        char frame_path[512];
+        snprintf(frame_path, sizeof(frame_path), "%s/frame_%06d.ppm", dir, (int) frame);
+        if (!write_ppm(frame_path, pixels, width, height)) {
+            frames = -1;
+            break;
+        }
+        frames++;
+    }
+    free(pixels);
+    fclose(f);
+    return frames;
+}
@@ -0,0 +1,229 @@
+/* Debug Console */
+#if CONSOLE_SOCKET
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
+
+/* A client gone before its reply must not kill the game with SIGPIPE */
+#ifdef MSG_NOSIGNAL
+#define CONSOLE_SEND_FLAGS (MSG_NOSIGNAL | MSG_DONTWAIT)
+#else
+#define CONSOLE_SEND_FLAGS MSG_DONTWAIT /* Clients get SO_NOSIGPIPE where it exists, or SIGPIPE is ignored */
+#endif
+#endif
+
+/*
+ * Commands come from the in-window overlay or from scripts over a local Unix domain socket. Neither
+ * source ever blocks: lines are queued as they complete and the game runs the whole queue at the
+ * next frame boundary.
+ */
+#define CONSOLE_LINE_LEN 96
+#define CONSOLE_HISTORY 8
+#define CONSOLE_QUEUE_LEN 16
+#define CONSOLE_MAX_CLIENTS 4
+#define CONSOLE_OVERLAY -1 /* Client index of commands typed into the overlay */
+
+typedef struct console_command {
+    char line[CONSOLE_LINE_LEN];
+    int client;
+} console_command;
+
+typedef struct console {
+    int open;
+    char edit[CONSOLE_LINE_LEN];
+    int edit_len;
+    /* Overlay scrollback, a ring of the last lines written */
+    char history[CONSOLE_HISTORY][CONSOLE_LINE_LEN];
+    int history_next;
+    console_command queue[CONSOLE_QUEUE_LEN];
+    int num_queued;
+#if CONSOLE_SOCKET
+    int listen_fd;
+    int client_fds[CONSOLE_MAX_CLIENTS];
+    char client_lines[CONSOLE_MAX_CLIENTS][CONSOLE_LINE_LEN];
+    int client_lens[CONSOLE_MAX_CLIENTS];
+    char socket_path[108];
+#endif
+} console;
+
+void console_queue(console* con, char* line, int client) {
+    if (con->num_queued == CONSOLE_QUEUE_LEN) return;
+    console_command* cmd = &con->queue[con->num_queued++];
+    snprintf(cmd->line, CONSOLE_LINE_LEN, "%s", line);
+    cmd->client = client;
+}
+
+/* Writes a response line to whoever sent the command, overlay lines go into the scrollback */
+void console_print(console* con, int client, const char* fmt, ...) {
+    char line[CONSOLE_LINE_LEN];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    if (client == CONSOLE_OVERLAY) {
+        strcpy(con->history[con->history_next], line);
+        con->history_next = (con->history_next + 1) % CONSOLE_HISTORY;
+    }
+#if CONSOLE_SOCKET
+    else if (con->client_fds[client] != -1) {
+        /* Replies are short, a client that can't take one line is dropped rather than waited on */
+        int len = strlen(line);
+        line[len++] = '\n';
+        if (send(con->client_fds[client], line, len, CONSOLE_SEND_FLAGS) != len) {
+            close(con->client_fds[client]);
+            con->client_fds[client] = -1;
+        }
+    }
+#endif
+}
+
+void console_toggle(console* con) {
+    con->open = !con->open;
+    con->edit_len = 0;
+    con->edit[0] = '\0';
+    if (con->open) SDL_StartTextInput();
+    else SDL_StopTextInput();
+}
+
+/* Overlay line editing from the frame's typed text */
+void console_edit(console* con, input_frame* in) {
+    if (in->cancel) {
+        console_toggle(con);
+        return;
+    }
+    while (in->backspaces-- > 0 && con->edit_len > 0) con->edit[--con->edit_len] = '\0';
+    for (int i = 0; i < in->text_len && con->edit_len < CONSOLE_LINE_LEN - 1; i++) {
+        if (in->text[i] == '`') continue; /* The key that opens the console */
+        con->edit[con->edit_len++] = in->text[i];
+    }
+    con->edit[con->edit_len] = '\0';
+
+    if (in->submit && con->edit_len) {
+        console_print(con, CONSOLE_OVERLAY, "> %s", con->edit);
+        console_queue(con, con->edit, CONSOLE_OVERLAY);
+        con->edit_len = 0;
+        con->edit[0] = '\0';
+    }
+}
+
+#if CONSOLE_SOCKET
+/* This process' own socket path, so several instances never share one */
+void console_default_path(char* path, size_t size) {
+    const char* dir = getenv("XDG_RUNTIME_DIR");
+    snprintf(path, size, "%s/%s-%d.sock", dir && dir[0] ? dir : "/tmp", CONSOLE_SOCKET_NAME, (int) getpid());
+}
+
+/* A socket file some live process still accepts on, as opposed to one left behind by a crash */
+int console_socket_live(struct sockaddr_un* addr) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) return FALSE;
+    int live = connect(fd, (struct sockaddr*) addr, sizeof(*addr)) == 0;
+    close(fd);
+    return live;
+}
+
+void console_init(console* con, const char* socket_path) {
+    memset(con, 0, sizeof(*con));
+    con->listen_fd = -1;
+    for (int i = 0; i < CONSOLE_MAX_CLIENTS; i++) con->client_fds[i] = -1;
+    if (!socket_path) return;
+#if !defined(MSG_NOSIGNAL) && !defined(SO_NOSIGPIPE)
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+    if (access(socket_path, F_OK) == 0) {
+        if (console_socket_live(&addr)) {
+            fprintf(stderr, "Error opening console socket %s: another instance is using it\n", socket_path);
+            return;
+        }
+        unlink(socket_path);
+    }
+    snprintf(con->socket_path, sizeof(con->socket_path), "%s", socket_path);
+
+    con->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (
+        con->listen_fd == -1 ||
+        fcntl(con->listen_fd, F_SETFL, O_NONBLOCK) == -1 ||
+        bind(con->listen_fd, (struct sockaddr*) &addr, sizeof(addr)) == -1 ||
+        listen(con->listen_fd, CONSOLE_MAX_CLIENTS) == -1
+    ) {
+        fprintf(stderr, "Error opening console socket %s: %s\n", socket_path, strerror(errno));
+        if (con->listen_fd != -1) close(con->listen_fd);
+        con->listen_fd = -1;
+    }
+}
+
+void console_free(console* con) {
+    for (int i = 0; i < CONSOLE_MAX_CLIENTS; i++) if (con->client_fds[i] != -1) close(con->client_fds[i]);
+    if (con->listen_fd != -1) {
+        close(con->listen_fd);
+        unlink(con->socket_path);
+    }
+}
+
+/* Accepts waiting clients and queues every complete line they sent, never waits on either */
+void console_poll(console* con) {
+    if (con->listen_fd == -1) return;
+
+    int fd;
+    while ((fd = accept(con->listen_fd, NULL, NULL)) != -1) {
+        int slot = 0;
+        while (slot < CONSOLE_MAX_CLIENTS && con->client_fds[slot] != -1) slot++;
+        if (slot == CONSOLE_MAX_CLIENTS || fcntl(fd, F_SETFL, O_NONBLOCK) == -1) {
+            close(fd);
+            continue;
+        }
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        con->client_fds[slot] = fd;
+        con->client_lens[slot] = 0;
+    }
+
+    for (int i = 0; i < CONSOLE_MAX_CLIENTS; i++) {
+        int closed = FALSE;
+        while (con->client_fds[i] != -1) {
+            char buf[256];
+            ssize_t got = recv(con->client_fds[i], buf, sizeof(buf), 0);
+            if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (got <= 0) {
+                closed = TRUE;
+                break;
+            }
+            for (int b = 0; b < got; b++) {
+                if (buf[b] == '\n' || buf[b] == '\r') {
+                    con->client_lines[i][con->client_lens[i]] = '\0';
+                    if (con->client_lens[i]) console_queue(con, con->client_lines[i], i);
+                    con->client_lens[i] = 0;
+                } else if (con->client_lens[i] < CONSOLE_LINE_LEN - 1) {
+                    con->client_lines[i][con->client_lens[i]++] = buf[b];
+                }
+            }
+        }
+        if (closed) {
+            close(con->client_fds[i]);
+            con->client_fds[i] = -1;
+        }
+    }
+}
+#else
+void console_default_path(char* path, size_t size) {
+    path[0] = '\0';
+}
+
+void console_init(console* con, const char* socket_path) {
+    memset(con, 0, sizeof(*con));
+}
+
+void console_free(console* con) {}
+
+void console_poll(console* con) {}
+#endif
@@ -9,7 +9,8 @@
 #define FPS 60
 #define FRAME_TARGET_TIME (1000 / FPS)
 
-#define GRID_SPACING 64
+#define GRID_SHIFT 6
+#define GRID_SPACING (1 << GRID_SHIFT) /* Must stay a power of two, the ray kernels step with shifts */
 
 typedef struct rgb {
     unsigned char r;
@@ -22,4 +23,21 @@ typedef struct rgb {
 #define C_YELLOW (rgb) {255, 255, 0}
 #define C_RED (rgb) {255, 0, 0}
 #define C_PURPLE (rgb) {255, 0, 255}
-#define C_BLUE (rgb) {0, 0, 255}
\ No newline at end of file
+#define C_BLUE (rgb) {0, 0, 255}
+/* Deterministic 16.16 fixed point ray stepping and player physics, see fixed.h */
+#ifndef FIXED_MATH
+#define FIXED_MATH FALSE
+#endif
+/* Ray traversal counters and the heatmap overlay, see raystats.h */
+#ifndef RAY_STATS
+#define RAY_STATS FALSE
+#endif
+/* Debug console control socket for scripts, see console.h */
+#ifndef CONSOLE_SOCKET
+#ifdef _WIN32
+#define CONSOLE_SOCKET FALSE
+#else
+#define CONSOLE_SOCKET TRUE
+#endif
+#endif
+#define CONSOLE_SOCKET_NAME "realRaycast" /* Sockets are NAME-PID.sock in $XDG_RUNTIME_DIR, or /tmp without it */
@@ -0,0 +1,62 @@
+/* Map Dirty Region Tracking */
+
+/*
+ * The grid is split into square regions of cells, each stamped with the generation of its latest
+ * change. Anything built from the map remembers the generation it was built at and only redoes the
+ * regions stamped after it, so a few cells changing never costs a full rebuild.
+ */
+#define DIRTY_REGION_SHIFT 3 /* 8x8 cell regions */
+
+/* Inclusive rectangle of cells */
+typedef struct cell_box {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+} cell_box;
+
+typedef struct dirty_tracker {
+    int regions_x;
+    int regions_y;
+    Uint32 gen; /* Latest generation handed out, every change takes a new one */
+    Uint32* region_gens;
+} dirty_tracker;
+
+void dirty_init(dirty_tracker* t, int grid_length, int grid_height) {
+    t->regions_x = (grid_length >> DIRTY_REGION_SHIFT) + 1;
+    t->regions_y = (grid_height >> DIRTY_REGION_SHIFT) + 1;
+    t->gen = 0;
+    t->region_gens = calloc(t->regions_x * t->regions_y, sizeof(*t->region_gens));
+}
+
+void dirty_free(dirty_tracker* t) {
+    free(t->region_gens);
+    t->region_gens = NULL;
+}
+
+void dirty_mark(dirty_tracker* t, int x, int y) {
+    t->region_gens[((y >> DIRTY_REGION_SHIFT) * t->regions_x) + (x >> DIRTY_REGION_SHIFT)] = ++t->gen;
+}
+
+void dirty_mark_all(dirty_tracker* t) {
+    t->gen++;
+    for (int i = 0; i < t->regions_x * t->regions_y; i++) t->region_gens[i] = t->gen;
+}
+
+/* Whether any cell in the inclusive cell rectangle may have changed after generation since */
+int dirty_rect_since(dirty_tracker* t, int x0, int y0, int x1, int y1, Uint32 since) {
+    if (since == t->gen) return FALSE;
+    int rx0 = x0 > 0 ? x0 >> DIRTY_REGION_SHIFT : 0;
+    int ry0 = y0 > 0 ? y0 >> DIRTY_REGION_SHIFT : 0;
+    int rx1 = x1 >> DIRTY_REGION_SHIFT;
+    int ry1 = y1 >> DIRTY_REGION_SHIFT;
+    if (rx1 >= t->regions_x) rx1 = t->regions_x - 1;
+    if (ry1 >= t->regions_y) ry1 = t->regions_y - 1;
+
+    for (int ry = ry0; ry <= ry1; ry++) {
+        for (int rx = rx0; rx <= rx1; rx++) {
+            if (t->region_gens[(ry * t->regions_x) + rx] > since) return TRUE;
+        }
+    }
+    return FALSE;
+}
@@ -0,0 +1,111 @@
+/* Fixed Point Math */
+
+/*
+ * Values carry 16 fractional bits. They are stored in 64 bits so world coordinates on large maps
+ * and the intermediate products in the ray kernels never overflow.
+ */
+typedef int64_t fixed;
+
+#define FX_SHIFT 16
+#define FX_ONE ((fixed) 1 << FX_SHIFT)
+#define FX_HALF (FX_ONE >> 1)
+#define FX_PI ((fixed) 205887) /* round(pi * 2^16) */
+#define FX_TWO_PI (FX_PI * 2)
+#define FX_HALF_PI (FX_PI / 2)
+
+#define int_fx(i) ((fixed) (i) * FX_ONE)
+#define fx_int(f) ((int) ((f) >> FX_SHIFT)) /* Floor */
+#define fx_round(f) ((int) (((f) + FX_HALF) >> FX_SHIFT))
+#define fx_flt(f) ((float) (f) / FX_ONE)
+#define flt_fx(f) ((fixed) llround((double) (f) * FX_ONE))
+#define fx_mul(a, b) (((a) * (b)) >> FX_SHIFT)
+#define fx_div(a, b) (((a) * FX_ONE) / (b))
+
+typedef struct fx_xy {
+    fixed x;
+    fixed y;
+} fx_xy;
+
+/* Trig Lookup */
+#define TRIG_LUT_BITS 14
+#define TRIG_LUT_SIZE (1 << TRIG_LUT_BITS)
+
+int32_t fx_sin_lut[TRIG_LUT_SIZE];
+
+/*
+ * Built with integer-only Taylor series in 2.30 fixed point so every machine gets the exact same table,
+ * no matter which libm it links against.
+ */
+void fx_trig_init(void) {
+    const int64_t two_pi_q30 = 6746518852LL; /* round(2pi * 2^30) */
+    const int64_t one_q30 = (int64_t) 1 << 30;
+    int quarter = TRIG_LUT_SIZE / 4;
+
+    for (int i = 0; i <= quarter; i++) {
+        int64_t x = (two_pi_q30 * i) / TRIG_LUT_SIZE;
+        int64_t x_sq = (x * x) >> 30;
+        int64_t term = x;
+        int64_t sum = x;
+        for (int n = 2; n <= 14; n += 2) {
+            term = -((term * x_sq) >> 30) / (n * (n + 1));
+            sum += term;
+        }
+        if (sum > one_q30) sum = one_q30;
+        int32_t val = (int32_t) ((sum + (1 << 13)) >> 14);
+
+        fx_sin_lut[i] = val;
+        fx_sin_lut[(TRIG_LUT_SIZE / 2) - i] = val;
+        fx_sin_lut[(TRIG_LUT_SIZE / 2) + i] = -val;
+        if (i != 0) fx_sin_lut[TRIG_LUT_SIZE - i] = -val;
+    }
+}
+
+fixed fx_wrap_angle(fixed angle) {
+    angle %= FX_TWO_PI;
+    if (angle < 0) angle += FX_TWO_PI;
+    return angle;
+}
+
+int fx_trig_index(fixed angle) {
+    return (int) (((fx_wrap_angle(angle) * TRIG_LUT_SIZE) + (FX_TWO_PI / 2)) / FX_TWO_PI) & (TRIG_LUT_SIZE - 1);
+}
+
+fixed fx_sin(fixed angle) {
+    return fx_sin_lut[fx_trig_index(angle)];
+}
+
+fixed fx_cos(fixed angle) {
+    return fx_sin_lut[(fx_trig_index(angle) + (TRIG_LUT_SIZE / 4)) & (TRIG_LUT_SIZE - 1)];
+}
+
+/* Integer square root, floor(sqrt(val)) */
+int64_t isqrt64(int64_t val) {
+    uint64_t op = val;
+    uint64_t res = 0;
+    uint64_t one = (uint64_t) 1 << 62;
+
+    if (val <= 0) return 0;
+    while (one > op) one >>= 2;
+    while (one) {
+        if (op >= res + one) {
+            op -= res + one;
+            res = (res >> 1) + one;
+        } else res >>= 1;
+        one >>= 2;
+    }
+    return res;
+}
+
+/* Length of (x, y), both already fixed point. Meant for velocities, the squares overflow past ~2^15 units */
+fixed fx_length(fixed x, fixed y) {
+    return isqrt64((x * x) + (y * y));
+}
+
+/* Squared length compared at 8 fractional bits, saturated so far off-grid points can't overflow */
+int64_t fx_dist_sq(fixed dx, fixed dy) {
+    const int64_t limit = (int64_t) 1 << 30;
+    dx >>= 8; dy >>= 8;
+    if (dx > limit) dx = limit; else if (dx < -limit) dx = -limit;
+    if (dy > limit) dy = limit; else if (dy < -limit) dy = -limit;
+    return (dx * dx) + (dy * dy);
+}
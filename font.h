@@ -0,0 +1,83 @@
+/* Bitmap Font */
+
+/*
+ * 5x7 glyphs for ' ' through '_', one byte per row with the leftmost pixel in bit 4.
+ * Lowercase letters draw as uppercase, anything else as '?'.
+ */
+#define FONT_WIDTH 5
+#define FONT_HEIGHT 7
+#define FONT_FIRST ' '
+#define FONT_LAST '_'
+
+unsigned char font_glyphs[FONT_LAST - FONT_FIRST + 1][FONT_HEIGHT] = {
+    {0x00,0x00,0x00,0x00,0x00,0x00,0x00}, /* ' ' */
+    {0x04,0x04,0x04,0x04,0x04,0x00,0x04}, /* ! */
+    {0x0A,0x0A,0x00,0x00,0x00,0x00,0x00}, /* " */
+    {0x0A,0x0A,0x1F,0x0A,0x1F,0x0A,0x0A}, /* # */
+    {0x04,0x0F,0x14,0x0E,0x05,0x1E,0x04}, /* $ */
+    {0x18,0x19,0x02,0x04,0x08,0x13,0x03}, /* % */
+    {0x0C,0x12,0x14,0x08,0x15,0x12,0x0D}, /* & */
+    {0x0C,0x04,0x08,0x00,0x00,0x00,0x00}, /* ' */
+    {0x02,0x04,0x08,0x08,0x08,0x04,0x02}, /* ( */
+    {0x08,0x04,0x02,0x02,0x02,0x04,0x08}, /* ) */
+    {0x00,0x04,0x15,0x0E,0x15,0x04,0x00}, /* * */
+    {0x00,0x04,0x04,0x1F,0x04,0x04,0x00}, /* + */
+    {0x00,0x00,0x00,0x00,0x0C,0x04,0x08}, /* , */
+    {0x00,0x00,0x00,0x1F,0x00,0x00,0x00}, /* - */
+    {0x00,0x00,0x00,0x00,0x00,0x0C,0x0C}, /* . */
+    {0x00,0x01,0x02,0x04,0x08,0x10,0x00}, /* / */
+    {0x0E,0x11,0x13,0x15,0x19,0x11,0x0E}, /* 0 */
+    {0x04,0x0C,0x04,0x04,0x04,0x04,0x0E}, /* 1 */
+    {0x0E,0x11,0x01,0x02,0x04,0x08,0x1F}, /* 2 */
+    {0x1F,0x02,0x04,0x02,0x01,0x11,0x0E}, /* 3 */
+    {0x02,0x06,0x0A,0x12,0x1F,0x02,0x02}, /* 4 */
+    {0x1F,0x10,0x1E,0x01,0x01,0x11,0x0E}, /* 5 */
+    {0x06,0x08,0x10,0x1E,0x11,0x11,0x0E}, /* 6 */
+    {0x1F,0x01,0x02,0x04,0x08,0x08,0x08}, /* 7 */
+    {0x0E,0x11,0x11,0x0E,0x11,0x11,0x0E}, /* 8 */
+    {0x0E,0x11,0x11,0x0F,0x01,0x02,0x0C}, /* 9 */
+    {0x00,0x0C,0x0C,0x00,0x0C,0x0C,0x00}, /* : */
+    {0x00,0x0C,0x0C,0x00,0x0C,0x04,0x08}, /* ; */
+    {0x02,0x04,0x08,0x10,0x08,0x04,0x02}, /* < */
+    {0x00,0x00,0x1F,0x00,0x1F,0x00,0x00}, /* = */
+    {0x08,0x04,0x02,0x01,0x02,0x04,0x08}, /* > */
+    {0x0E,0x11,0x01,0x02,0x04,0x00,0x04}, /* ? */
+    {0x0E,0x11,0x17,0x15,0x17,0x10,0x0E}, /* @ */
+    {0x0E,0x11,0x11,0x1F,0x11,0x11,0x11}, /* A */
+    {0x1E,0x11,0x11,0x1E,0x11,0x11,0x1E}, /* B */
+    {0x0E,0x11,0x10,0x10,0x10,0x11,0x0E}, /* C */
+    {0x1E,0x11,0x11,0x11,0x11,0x11,0x1E}, /* D */
+    {0x1F,0x10,0x10,0x1E,0x10,0x10,0x1F}, /* E */
+    {0x1F,0x10,0x10,0x1E,0x10,0x10,0x10}, /* F */
+    {0x0E,0x11,0x10,0x17,0x11,0x11,0x0F}, /* G */
+    {0x11,0x11,0x11,0x1F,0x11,0x11,0x11}, /* H */
+    {0x0E,0x04,0x04,0x04,0x04,0x04,0x0E}, /* I */
+    {0x07,0x02,0x02,0x02,0x02,0x12,0x0C}, /* J */
+    {0x11,0x12,0x14,0x18,0x14,0x12,0x11}, /* K */
+    {0x10,0x10,0x10,0x10,0x10,0x10,0x1F}, /* L */
+    {0x11,0x1B,0x15,0x15,0x11,0x11,0x11}, /* M */
+    {0x11,0x11,0x19,0x15,0x13,0x11,0x11}, /* N */
+    {0x0E,0x11,0x11,0x11,0x11,0x11,0x0E}, /* O */
+    {0x1E,0x11,0x11,0x1E,0x10,0x10,0x10}, /* P */
+    {0x0E,0x11,0x11,0x11,0x15,0x12,0x0D}, /* Q */
+    {0x1E,0x11,0x11,0x1E,0x14,0x12,0x11}, /* R */
+    {0x0F,0x10,0x10,0x0E,0x01,0x01,0x1E}, /* S */
+    {0x1F,0x04,0x04,0x04,0x04,0x04,0x04}, /* T */
+    {0x11,0x11,0x11,0x11,0x11,0x11,0x0E}, /* U */
+    {0x11,0x11,0x11,0x11,0x11,0x0A,0x04}, /* V */
+    {0x11,0x11,0x11,0x15,0x15,0x15,0x0A}, /* W */
+    {0x11,0x11,0x0A,0x04,0x0A,0x11,0x11}, /* X */
+    {0x11,0x11,0x0A,0x04,0x04,0x04,0x04}, /* Y */
+    {0x1F,0x01,0x02,0x04,0x08,0x10,0x1F}, /* Z */
+    {0x0E,0x08,0x08,0x08,0x08,0x08,0x0E}, /* [ */
+    {0x00,0x10,0x08,0x04,0x02,0x01,0x00}, /* \ */
+    {0x0E,0x02,0x02,0x02,0x02,0x02,0x0E}, /* ] */
+    {0x04,0x0A,0x11,0x00,0x00,0x00,0x00}, /* ^ */
+    {0x00,0x00,0x00,0x00,0x00,0x00,0x1F}  /* _ */
+};
+
+unsigned char* font_glyph(char c) {
+    if ('a' <= c && c <= 'z') c -= 'a' - 'A';
+    if (c < FONT_FIRST || c > FONT_LAST) c = '?';
+    return font_glyphs[c - FONT_FIRST];
+}
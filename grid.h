@@ -1,5 +1,7 @@
 #define bool_cont unsigned char
 #define SIZE_BOOL_CONT sizeof(bool_cont)
+#define BOOL_CONT_BITS (SIZE_BOOL_CONT * 8)
+#define BOOL_CONT_SHIFT 3 /* log2(BOOL_CONT_BITS) */
 
 char rep[SIZE_BOOL_CONT * 8];
 
@@ -0,0 +1,128 @@
+/* Wall Heights */
+
+/*
+ * On maps with a wall layer a ray doesn't stop at the first wall. It walks the grid cell by cell and
+ * keeps a span for every wall it enters, nearest first, until one is tall enough that nothing behind
+ * it can show. Each span is drawn clipped to the column's horizon, the highest row drawn so far, so
+ * no pixel is drawn twice. Walls below eye level also get a span where the ray leaves them, which
+ * fills in their top between the near and far edges. Maps without a layer keep the single hit kernels.
+ */
+#define MAX_WALL_SPANS 8
+
+typedef struct wall_span {
+#if FIXED_MATH
+    fx_xy hit;
+#else
+    xy hit;
+#endif
+    char height; /* In eighths of a full wall */
+    char material;
+    char top; /* The far edge of a wall below eye level, drawn down to the face in front to show its top */
+} wall_span;
+
+/* Solid cells give their layer byte, open ones -1 */
+int span_cell(world* w, int x, int y) {
+    return get_grid_bool(w, x, y) ? get_wall_info(w, x, y) : -1;
+}
+
+/*
+ * Adds the spans for stepping from the last cell into one holding cell at hit. Returns FALSE once a
+ * wall hides everything behind it or the spans run out.
+ */
+#if FIXED_MATH
+int add_wall_spans(world* w, wall_span* spans, int* num_spans, int* run, int cell, fx_xy hit) {
+#else
+int add_wall_spans(world* w, wall_span* spans, int* num_spans, int* run, int cell, xy hit) {
+#endif
+    if (cell == *run) return TRUE; /* Deeper into the same wall, its faces here are behind the front one */
+    int run_height = (*run & 15) ? *run & 15 : WALL_HEIGHT_FULL;
+    if (*run >= 0 && run_height * 2 < WALL_HEIGHT_FULL) spans[(*num_spans)++] = (wall_span) {hit, run_height, *run >> 4, TRUE};
+    *run = cell;
+    if (cell < 0) return TRUE;
+
+    int height = (cell & 15) ? cell & 15 : WALL_HEIGHT_FULL;
+    spans[(*num_spans)++] = (wall_span) {hit, height, cell >> 4, FALSE};
+    return !(height >= w->tallest_wall && height * 2 >= WALL_HEIGHT_FULL) && *num_spans < MAX_WALL_SPANS - 1;
+}
+
+#if RAY_STATS
+/*
+ * Each crossed line is counted as a line test with nothing tested past the hit. Every step onto the
+ * map read its cell once, only the last can have left it.
+ */
+#define SPAN_STATS_RECORD(SX, SY, H_TESTS, V_TESTS, LOOKUPS, CELL_X, CELL_Y) \
+    if (ray_stats_sink) ray_stats_record(ray_stats_sink, w->grid_length, w->grid_height, SX, SY, H_TESTS, V_TESTS, LOOKUPS, \
+        (CELL_Y) + ((SY) > 0), (CELL_X) + ((SX) > 0), FALSE, CELL_X, CELL_Y);
+#else
+#define SPAN_STATS_RECORD(...)
+#endif
+
+/*
+ * Fills spans front to back along the ray and returns how many. Steps one cell at a time, crossing
+ * whichever grid line comes first, so hits land exactly on the line they crossed.
+ */
+#if FIXED_MATH
+int raycast_spans(world* w, fixed x, fixed y, fixed angle, wall_span* spans) {
+    fixed dx = fx_cos(angle), dy = fx_sin(angle);
+    int sx = dx < 0 ? -1 : 1, sy = dy < 0 ? -1 : 1;
+    int cx = x >> FX_CELL_SHIFT, cy = y >> FX_CELL_SHIFT;
+    /* Ray lengths to the next vertical and horizontal lines, and between lines */
+    fixed next_x = dx ? fx_div(((fixed) (cx + (sx > 0)) << FX_CELL_SHIFT) - x, dx) : INT64_MAX;
+    fixed next_y = dy ? fx_div(((fixed) (cy + (sy > 0)) << FX_CELL_SHIFT) - y, dy) : INT64_MAX;
+    fixed step_x = dx ? fx_div(FX_GRID_SPACING, dx * sx) : 0;
+    fixed step_y = dy ? fx_div(FX_GRID_SPACING, dy * sy) : 0;
+    /*
+     * The rounded lengths drift apart over many lines, so which line comes first is decided on the
+     * distances to them scaled by the other axis' direction, exact integers stepped by exact amounts
+     */
+    fixed cross_x = ((((fixed) (cx + (sx > 0)) << FX_CELL_SHIFT) - x) * sx) * (dy * sy);
+    fixed cross_y = ((((fixed) (cy + (sy > 0)) << FX_CELL_SHIFT) - y) * sy) * (dx * sx);
+#else
+int raycast_spans(world* w, int x, int y, float angle, wall_span* spans) {
+    double dx = cos(angle), dy = sin(angle);
+    int sx = dx < 0 ? -1 : 1, sy = dy < 0 ? -1 : 1;
+    int cx = x >> GRID_SHIFT, cy = y >> GRID_SHIFT;
+    double next_x = dx != 0 ? ((((cx + (sx > 0)) << GRID_SHIFT) - x) / dx) : INFINITY;
+    double next_y = dy != 0 ? ((((cy + (sy > 0)) << GRID_SHIFT) - y) / dy) : INFINITY;
+    double step_x = dx != 0 ? GRID_SPACING / fabs(dx) : 0;
+    double step_y = dy != 0 ? GRID_SPACING / fabs(dy) : 0;
+#endif
+    int num_spans = 0, run = -1, going = TRUE;
+    int h_tests = 0, v_tests = 0;
+
+    while (going) {
+#if FIXED_MATH
+        fx_xy hit;
+        if (cross_x < cross_y) {
+            cx += sx;
+            hit = (fx_xy) {(fixed) (cx + (sx < 0)) << FX_CELL_SHIFT, y + fx_mul(next_x, dy)};
+            next_x += step_x;
+            cross_x += FX_GRID_SPACING * (dy * sy);
+            v_tests++;
+        } else {
+            cy += sy;
+            hit = (fx_xy) {x + fx_mul(next_y, dx), (fixed) (cy + (sy < 0)) << FX_CELL_SHIFT};
+            next_y += step_y;
+            cross_y += FX_GRID_SPACING * (dx * sx);
+            h_tests++;
+        }
+#else
+        xy hit;
+        if (next_x < next_y) {
+            cx += sx;
+            hit = (xy) {(cx + (sx < 0)) << GRID_SHIFT, y + (next_x * dy)};
+            next_x += step_x;
+            v_tests++;
+        } else {
+            cy += sy;
+            hit = (xy) {x + (next_y * dx), (cy + (sy < 0)) << GRID_SHIFT};
+            next_y += step_y;
+            h_tests++;
+        }
+#endif
+        int on_map = in_grid(w, cx, cy); /* Off the map counts as a full wall, and the last one */
+        going = add_wall_spans(w, spans, &num_spans, &run, on_map ? span_cell(w, cx, cy) : 0, hit) && on_map;
+    }
+    SPAN_STATS_RECORD(sx, sy, h_tests, v_tests, h_tests + v_tests - !in_grid(w, cx, cy), SDL_min(SDL_max(cx, 0), w->grid_length - 1), SDL_min(SDL_max(cy, 0), w->grid_height - 1))
+    return num_spans;
+}
@@ -0,0 +1,99 @@
+/* Input */
+typedef struct input_frame {
+    int quit;
+    int left_mouse_down;
+    int mouse_x;
+    int mouse_y;
+    int drag_x; /* Mouse motion merged over the frame while the left button was held */
+    int drag_y;
+    int wheel_y; /* Wheel motion merged over the frame */
+    int num_events;
+    Uint64 oldest_event_time; /* Performance counter when the first event drained this frame was queued */
+    Uint64 sample_time; /* Performance counter at the moment input was sampled */
+    const Uint8* keys;
+    /* Typed text and editing keys, only collected while text input is on (the console is open) */
+    char text[64];
+    int text_len;
+    int backspaces;
+    int submit;
+    int cancel;
+} input_frame;
+
+void input_init(input_frame* in) {
+    memset(in, 0, sizeof(*in));
+    in->mouse_x = -1;
+    in->mouse_y = -1;
+    in->keys = SDL_GetKeyboardState(NULL);
+    SDL_StopTextInput(); /* SDL starts with text input on, the console turns it on when it opens */
+}
+
+/* Drains every pending event, merging motion and wheel deltas, then samples the keyboard */
+void input_poll(input_frame* in) {
+    SDL_Event event;
+
+    in->drag_x = 0;
+    in->drag_y = 0;
+    in->wheel_y = 0;
+    in->num_events = 0;
+    in->oldest_event_time = 0;
+    in->text_len = 0;
+    in->text[0] = '\0';
+    in->backspaces = 0;
+    in->submit = FALSE;
+    in->cancel = FALSE;
+
+    while (SDL_PollEvent(&event)) {
+        if (in->num_events++ == 0) {
+            /* SDL only stamps whole milliseconds, so move the stamp onto the counter by how long ago it was */
+            Uint64 now = SDL_GetPerformanceCounter();
+            Uint32 waited_ms = SDL_GetTicks() - event.common.timestamp;
+            in->oldest_event_time = now - SDL_min((Uint64) waited_ms * SDL_GetPerformanceFrequency() / 1000, now);
+        }
+
+        switch (event.type) {
+            case SDL_QUIT:
+                in->quit = TRUE;
+                break;
+            case SDL_MOUSEBUTTONUP:
+                if (event.button.button == SDL_BUTTON_LEFT) in->left_mouse_down = FALSE;
+                break;
+            case SDL_MOUSEBUTTONDOWN:
+                if (event.button.button == SDL_BUTTON_LEFT) in->left_mouse_down = TRUE;
+                break;
+            case SDL_MOUSEWHEEL:
+                in->wheel_y += event.wheel.y;
+                break;
+            case SDL_TEXTINPUT: {
+                int len = strlen(event.text.text);
+                if (in->text_len + len < (int) sizeof(in->text)) {
+                    memcpy(in->text + in->text_len, event.text.text, len + 1);
+                    in->text_len += len;
+                }
+                break;
+            }
+            case SDL_KEYDOWN:
+                if (!SDL_IsTextInputActive()) break;
+                if (event.key.keysym.scancode == SDL_SCANCODE_BACKSPACE) in->backspaces++;
+                else if (event.key.keysym.scancode == SDL_SCANCODE_RETURN) in->submit = TRUE;
+                else if (event.key.keysym.scancode == SDL_SCANCODE_ESCAPE) in->cancel = TRUE;
+                break;
+            case SDL_MOUSEMOTION:
+                if (in->mouse_x != -1 && in->mouse_y != -1 && in->left_mouse_down) {
+                    in->drag_x += event.motion.x - in->mouse_x;
+                    in->drag_y += event.motion.y - in->mouse_y;
+                }
+                in->mouse_x = event.motion.x;
+                in->mouse_y = event.motion.y;
+                break;
+        }
+    }
+
+    /* The event queue is pumped by SDL_PollEvent, so the keyboard state is current as of now */
+    in->sample_time = SDL_GetPerformanceCounter();
+}
+
+/* Milliseconds the oldest event of the frame waited in the queue before it was sampled */
+float input_queue_delay(input_frame* in) {
+    if (!in->num_events) return 0;
+    return (double) (in->sample_time - in->oldest_event_time) * 1000 / SDL_GetPerformanceFrequency();
+}
@@ -0,0 +1,282 @@
+/* Baked Lighting */
+
+/*
+ * Point lights are baked into one light level per wall face and per floor cell, so shading a wall
+ * column at runtime is a single lookup. Levels are 0 to 255 with LIGHT_NEUTRAL leaving a color as it is.
+ * A full bake runs on every core at load time, after that only the cells near a changed grid region
+ * or a changed light are baked again.
+ */
+#define LIGHT_NORTH 0
+#define LIGHT_EAST 1
+#define LIGHT_SOUTH 2
+#define LIGHT_WEST 3
+#define LIGHT_FLOOR 4
+#define LIGHT_SLOTS 5 /* Per cell: four faces, used on solid cells, and the floor, used on open ones */
+#define LIGHT_NEUTRAL 128
+#define MAX_LIGHTS 32
+#define MAX_DIRTY_LIGHT_BOXES 64
+#define LIGHT_THREADED_MIN_CELLS 256 /* Smaller rebakes aren't worth starting threads for */
+
+typedef struct point_light {
+    int x;
+    int y;
+    int intensity; /* Light level added right at the light, falling off linearly to 0 at radius */
+    int radius;
+} point_light;
+
+typedef struct lightmap {
+    int grid_length;
+    int grid_height;
+    Uint8* levels; /* LIGHT_SLOTS per cell */
+    Uint8* marks; /* Cells waiting for a rebake */
+    int ambient;
+    Uint32 gen; /* Dirty tracker generation the levels match */
+    point_light lights[MAX_LIGHTS];
+    int num_lights;
+    /* Areas that changed lights lit, rebaked by the next sync */
+    cell_box dirty_boxes[MAX_DIRTY_LIGHT_BOXES];
+    int num_dirty_boxes;
+    int rebake_all;
+    int last_bake_cells; /* For the console */
+    Uint64 last_bake_time;
+} lightmap;
+
+void lightmap_init(lightmap* lm) {
+    memset(lm, 0, sizeof(*lm));
+    lm->ambient = 64;
+    lm->rebake_all = TRUE;
+}
+
+void lightmap_free(lightmap* lm) {
+    free(lm->levels);
+    free(lm->marks);
+    lm->levels = NULL;
+    lm->marks = NULL;
+}
+
+cell_box light_box(point_light* l) {
+    return (cell_box) {
+        (l->x - l->radius) >> GRID_SHIFT, (l->y - l->radius) >> GRID_SHIFT,
+        (l->x + l->radius) >> GRID_SHIFT, (l->y + l->radius) >> GRID_SHIFT
+    };
+}
+
+void lightmap_dirty_box(lightmap* lm, cell_box box) {
+    if (lm->num_dirty_boxes == MAX_DIRTY_LIGHT_BOXES) lm->rebake_all = TRUE;
+    else lm->dirty_boxes[lm->num_dirty_boxes++] = box;
+}
+
+int lightmap_add_light(lightmap* lm, int x, int y, int intensity, int radius) {
+    if (lm->num_lights == MAX_LIGHTS || intensity < 0 || radius <= 0) return FALSE;
+    point_light* l = &lm->lights[lm->num_lights++];
+    *l = (point_light) {x, y, intensity, radius};
+    lightmap_dirty_box(lm, light_box(l));
+    return TRUE;
+}
+
+void lightmap_clear_lights(lightmap* lm) {
+    for (int i = 0; i < lm->num_lights; i++) lightmap_dirty_box(lm, light_box(&lm->lights[i]));
+    lm->num_lights = 0;
+}
+
+/* Whether light from (lx, ly) reaches (px, py) before any wall */
+int light_reaches(world* w, int lx, int ly, int px, int py) {
+    float dx = px - lx;
+    float dy = py - ly;
+    float angle = atan2(dy, dx);
+    if (angle < 0) angle += M_PI * 2;
+#if FIXED_MATH
+    fx_xy fx_hit = raycast(w, int_fx(lx), int_fx(ly), fx_wrap_angle(flt_fx(angle)), FALSE);
+    float hx = fx_flt(fx_hit.x) - lx;
+    float hy = fx_flt(fx_hit.y) - ly;
+#else
+    xy hit = raycast(w, lx, ly, angle, FALSE);
+    float hx = hit.x - lx;
+    float hy = hit.y - ly;
+#endif
+    /* Sample points sit a unit off their wall, so the ray to them stops just behind */
+    float reach = sqrt((dx * dx) + (dy * dy)) - 2;
+    return reach <= 0 || (hx * hx) + (hy * hy) >= reach * reach;
+}
+
+/* Light level at (px, py), nx and ny is the facing of the lit surface or 0, 0 for the floor */
+int light_level(lightmap* lm, world* w, int px, int py, int nx, int ny) {
+    float level = lm->ambient;
+    for (int i = 0; i < lm->num_lights; i++) {
+        point_light* l = &lm->lights[i];
+        float dx = l->x - px;
+        float dy = l->y - py;
+        float dist = sqrt((dx * dx) + (dy * dy));
+        if (dist >= l->radius) continue;
+        float facing = 1;
+        if (nx || ny) {
+            if (dist == 0) continue;
+            facing = ((dx * nx) + (dy * ny)) / dist;
+            if (facing <= 0) continue;
+        }
+        if (!light_reaches(w, l->x, l->y, px, py)) continue;
+        level += l->intensity * (1 - (dist / l->radius)) * facing;
+    }
+    return SDL_min(SDL_max(level, 0), 255); /* Ambient can be set below 0 */
+}
+
+void bake_cell(lightmap* lm, world* w, int x, int y) {
+    static const int face_nx[4] = {0, 1, 0, -1};
+    static const int face_ny[4] = {-1, 0, 1, 0};
+    Uint8* slots = &lm->levels[((y * lm->grid_length) + x) * LIGHT_SLOTS];
+    int half = GRID_SPACING / 2;
+
+    memset(slots, 0, LIGHT_SLOTS);
+    if (!get_grid_bool(w, x, y)) {
+        slots[LIGHT_FLOOR] = light_level(lm, w, (x * GRID_SPACING) + half, (y * GRID_SPACING) + half, 0, 0);
+        return;
+    }
+    for (int face = 0; face < 4; face++) {
+        int nx = face_nx[face], ny = face_ny[face];
+        if (!in_grid(w, x + nx, y + ny) || get_grid_bool(w, x + nx, y + ny)) continue; /* Never seen */
+        /* Middle of the face, one unit out into the open cell */
+        int px = (x * GRID_SPACING) + half + (nx * (half + 1));
+        int py = (y * GRID_SPACING) + half + (ny * (half + 1));
+        slots[face] = light_level(lm, w, px, py, nx, ny);
+    }
+}
+
+/* Bake Threads */
+typedef struct bake_job {
+    lightmap* lm;
+    world* w;
+    int* cells; /* Cell indices, or NULL to bake every cell from first to last */
+    int first;
+    int last;
+} bake_job;
+
+int bake_thread(void* data) {
+    bake_job* job = data;
+    for (int i = job->first; i < job->last; i++) {
+        int cell = job->cells ? job->cells[i] : i;
+        bake_cell(job->lm, job->w, cell % job->lm->grid_length, cell / job->lm->grid_length);
+    }
+    return 0;
+}
+
+/* Splits the cells across one thread per core, the world must not change until it returns */
+void bake_cells(lightmap* lm, world* w, int* cells, int num_cells) {
+    bake_job jobs[64];
+    SDL_Thread* threads[64];
+    int num_threads = num_cells < LIGHT_THREADED_MIN_CELLS ? 1 : SDL_min(SDL_max(SDL_GetCPUCount(), 1), 64);
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    for (int t = 0; t < num_threads; t++) {
+        jobs[t] = (bake_job) {lm, w, cells, (num_cells * t) / num_threads, (num_cells * (t + 1)) / num_threads};
+        threads[t] = t == 0 ? NULL : SDL_CreateThread(bake_thread, "light bake", &jobs[t]);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        if (threads[t]) SDL_WaitThread(threads[t], NULL);
+        else bake_thread(&jobs[t]); /* The first slice, or a thread that failed to start */
+    }
+    lm->last_bake_cells = num_cells;
+    lm->last_bake_time = SDL_GetPerformanceCounter() - start;
+}
+
+void mark_box(lightmap* lm, cell_box box) {
+    int x0 = SDL_max(box.x0, 0), y0 = SDL_max(box.y0, 0);
+    int x1 = SDL_min(box.x1, lm->grid_length - 1), y1 = SDL_min(box.y1, lm->grid_height - 1);
+    for (int y = y0; y <= y1; y++) memset(&lm->marks[(y * lm->grid_length) + x0], 1, SDL_max(x1 - x0 + 1, 0));
+}
+
+int boxes_overlap(cell_box a, cell_box b) {
+    return a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1;
+}
+
+/* Brings the lightmap up to the world's grid and the current lights */
+void lightmap_sync(lightmap* lm, world* w) {
+    int num_cells = w->grid_length * w->grid_height;
+
+    if (!lm->levels || lm->grid_length != w->grid_length || lm->grid_height != w->grid_height) {
+        lightmap_free(lm);
+        lm->grid_length = w->grid_length;
+        lm->grid_height = w->grid_height;
+        lm->levels = calloc(num_cells, LIGHT_SLOTS);
+        lm->marks = calloc(num_cells, 1);
+        lm->rebake_all = TRUE;
+    }
+
+    if (lm->rebake_all) {
+        bake_cells(lm, w, NULL, num_cells);
+        lm->rebake_all = FALSE;
+        lm->num_dirty_boxes = 0;
+        lm->gen = w->dirty.gen;
+        return;
+    }
+    if (lm->gen == w->dirty.gen && !lm->num_dirty_boxes) return;
+
+    /* A changed cell changes its neighbours' faces and the shadows of every light reaching it */
+    dirty_tracker* t = &w->dirty;
+    int region = 1 << DIRTY_REGION_SHIFT;
+    for (int ry = 0; ry < t->regions_y; ry++) {
+        for (int rx = 0; rx < t->regions_x; rx++) {
+            if (t->region_gens[(ry * t->regions_x) + rx] <= lm->gen) continue;
+            cell_box box = {(rx * region) - 1, (ry * region) - 1, (rx + 1) * region, (ry + 1) * region};
+            mark_box(lm, box);
+            for (int i = 0; i < lm->num_lights; i++) {
+                if (boxes_overlap(box, light_box(&lm->lights[i]))) mark_box(lm, light_box(&lm->lights[i]));
+            }
+        }
+    }
+    for (int i = 0; i < lm->num_dirty_boxes; i++) mark_box(lm, lm->dirty_boxes[i]);
+    lm->num_dirty_boxes = 0;
+
+    int* cells = malloc(num_cells * sizeof(*cells));
+    int num_marked = 0;
+    for (int i = 0; i < num_cells; i++) {
+        if (!lm->marks[i]) continue;
+        lm->marks[i] = 0;
+        cells[num_marked++] = i;
+    }
+    bake_cells(lm, w, cells, num_marked);
+    free(cells);
+    lm->gen = w->dirty.gen;
+}
+
+/*
+ * Level of the wall face a ray hit. on_horizontal says the hit lies on a horizontal grid line, and
+ * forward says the ray travels down (for horizontal lines) or right (for vertical ones). The stepping
+ * loops stop on either cell beside a line, so the far cell's face is the fallback.
+ */
+int lightmap_wall_level(lightmap* lm, int hit_x, int hit_y, int on_horizontal, int forward) {
+    int x, y, face, bx, by, back_face;
+    if (on_horizontal) {
+        x = bx = hit_x >> GRID_SHIFT;
+        y = (hit_y >> GRID_SHIFT) - !forward;
+        by = (hit_y >> GRID_SHIFT) - forward;
+        face = forward ? LIGHT_NORTH : LIGHT_SOUTH;
+        back_face = forward ? LIGHT_SOUTH : LIGHT_NORTH;
+    } else {
+        y = by = hit_y >> GRID_SHIFT;
+        x = (hit_x >> GRID_SHIFT) - !forward;
+        bx = (hit_x >> GRID_SHIFT) - forward;
+        face = forward ? LIGHT_WEST : LIGHT_EAST;
+        back_face = forward ? LIGHT_EAST : LIGHT_WEST;
+    }
+    if (0 <= x && x < lm->grid_length && 0 <= y && y < lm->grid_height) {
+        int level = lm->levels[(((y * lm->grid_length) + x) * LIGHT_SLOTS) + face];
+        if (level) return level;
+    }
+    if (0 <= bx && bx < lm->grid_length && 0 <= by && by < lm->grid_height) {
+        int level = lm->levels[(((by * lm->grid_length) + bx) * LIGHT_SLOTS) + back_face];
+        if (level) return level;
+    }
+    return SDL_min(SDL_max(lm->ambient, 0), 255);
+}
+
+int lightmap_floor_level(lightmap* lm, int x, int y) {
+    return lm->levels[(((y * lm->grid_length) + x) * LIGHT_SLOTS) + LIGHT_FLOOR];
+}
+
+rgb light_rgb(rgb color, int level) {
+    return (rgb) {
+        SDL_min((color.r * level) / LIGHT_NEUTRAL, 255),
+        SDL_min((color.g * level) / LIGHT_NEUTRAL, 255),
+        SDL_min((color.b * level) / LIGHT_NEUTRAL, 255)
+    };
+}
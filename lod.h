@@ -0,0 +1,202 @@
+/* Level Of Detail Map View */
+
+/*
+ * The map view draws textured tiles instead of cells. Level 0 has one texel per cell, higher levels
+ * one texel per block of cells, colored by how much of the block is solid. The level is picked so a
+ * texel stays a couple of pixels wide, which keeps the visible tile count small at any zoom. Tiles
+ * are only built once seen, and map edits update just the texels of the changed dirty regions.
+ */
+#define LOD_LEVELS 4
+#define LOD_TILE_TEXELS 128
+#define LOD_MIN_TEXEL_PX 2
+
+int lod_factors[LOD_LEVELS] = {1, 2, 4, 16}; /* Cells per block side, each a multiple of the last */
+
+typedef struct lod_tile {
+    SDL_Texture* texture;
+    Uint32 gen;
+} lod_tile;
+
+typedef struct lod_map {
+    int grid_length;
+    int grid_height;
+    Uint32 gen; /* Dirty tracker generation the counts match */
+    int blocks_x[LOD_LEVELS];
+    int blocks_y[LOD_LEVELS];
+    Uint16* counts[LOD_LEVELS]; /* Solid cells per block, none kept for level 0 */
+    int tiles_x[LOD_LEVELS];
+    int tiles_y[LOD_LEVELS];
+    lod_tile* tiles[LOD_LEVELS];
+    Uint32 texels[LOD_TILE_TEXELS * LOD_TILE_TEXELS];
+    int level; /* Last level drawn, for the console */
+    int failed; /* Textures are unavailable, the caller draws cells instead */
+} lod_map;
+
+void lod_free(lod_map* lod) {
+    for (int l = 0; l < LOD_LEVELS; l++) {
+        for (int i = 0; lod->tiles[l] && i < lod->tiles_x[l] * lod->tiles_y[l]; i++) {
+            if (lod->tiles[l][i].texture) SDL_DestroyTexture(lod->tiles[l][i].texture);
+        }
+        free(lod->tiles[l]);
+        free(lod->counts[l]);
+        lod->tiles[l] = NULL;
+        lod->counts[l] = NULL;
+    }
+}
+
+/* Recounts one block, from the cells for level 1 and from the level below for the rest */
+void lod_recount(lod_map* lod, world* w, int l, int bx, int by) {
+    int ratio = lod_factors[l] / lod_factors[l - 1];
+    int count = 0;
+    for (int y = by * ratio; y < (by + 1) * ratio; y++) {
+        for (int x = bx * ratio; x < (bx + 1) * ratio; x++) {
+            if (x >= lod->blocks_x[l - 1] || y >= lod->blocks_y[l - 1]) continue;
+            count += l == 1 ? get_grid_bool(w, x, y) : lod->counts[l - 1][(y * lod->blocks_x[l - 1]) + x];
+        }
+    }
+    lod->counts[l][(by * lod->blocks_x[l]) + bx] = count;
+}
+
+void lod_recount_box(lod_map* lod, world* w, cell_box box) {
+    for (int l = 1; l < LOD_LEVELS; l++) {
+        int f = lod_factors[l];
+        int bx1 = SDL_min(box.x1 / f, lod->blocks_x[l] - 1);
+        int by1 = SDL_min(box.y1 / f, lod->blocks_y[l] - 1);
+        for (int by = box.y0 / f; by <= by1; by++) {
+            for (int bx = box.x0 / f; bx <= bx1; bx++) lod_recount(lod, w, l, bx, by);
+        }
+    }
+}
+
+/* Keeps the block counts current, recounting only the dirty regions since the last sync */
+void lod_sync(lod_map* lod, world* w) {
+    if (!lod->tiles[0] || lod->grid_length != w->grid_length || lod->grid_height != w->grid_height) {
+        lod_free(lod);
+        lod->grid_length = w->grid_length;
+        lod->grid_height = w->grid_height;
+        for (int l = 0; l < LOD_LEVELS; l++) {
+            int f = lod_factors[l];
+            lod->blocks_x[l] = (w->grid_length + f - 1) / f;
+            lod->blocks_y[l] = (w->grid_height + f - 1) / f;
+            lod->tiles_x[l] = (lod->blocks_x[l] + LOD_TILE_TEXELS - 1) / LOD_TILE_TEXELS;
+            lod->tiles_y[l] = (lod->blocks_y[l] + LOD_TILE_TEXELS - 1) / LOD_TILE_TEXELS;
+            lod->tiles[l] = calloc(lod->tiles_x[l] * lod->tiles_y[l], sizeof(lod_tile));
+            if (l) lod->counts[l] = calloc(lod->blocks_x[l] * lod->blocks_y[l], sizeof(Uint16));
+        }
+        lod_recount_box(lod, w, (cell_box) {0, 0, w->grid_length - 1, w->grid_height - 1});
+        lod->gen = w->dirty.gen;
+        return;
+    }
+    if (lod->gen == w->dirty.gen) return;
+
+    dirty_tracker* t = &w->dirty;
+    int region = 1 << DIRTY_REGION_SHIFT;
+    for (int ry = 0; ry < t->regions_y; ry++) {
+        for (int rx = 0; rx < t->regions_x; rx++) {
+            if (t->region_gens[(ry * t->regions_x) + rx] <= lod->gen) continue;
+            lod_recount_box(lod, w, (cell_box) {rx * region, ry * region, ((rx + 1) * region) - 1, ((ry + 1) * region) - 1});
+        }
+    }
+    lod->gen = w->dirty.gen;
+}
+
+int lod_pick_level(float zoom_p) {
+    for (int l = 0; l < LOD_LEVELS; l++) {
+        if (GRID_SPACING * lod_factors[l] * zoom_p >= LOD_MIN_TEXEL_PX) return l;
+    }
+    return LOD_LEVELS - 1;
+}
+
+Uint32 lod_texel(lod_map* lod, world* w, int l, int bx, int by, rgb empty, rgb solid) {
+    int f = lod_factors[l];
+    int num = 255;
+    if (l == 0) num = get_grid_bool(w, bx, by) ? 255 : 0;
+    else {
+        int cells = SDL_min(f, w->grid_length - (bx * f)) * SDL_min(f, w->grid_height - (by * f));
+        num = (lod->counts[l][(by * lod->blocks_x[l]) + bx] * 255) / cells;
+    }
+    Uint32 r = empty.r + (((solid.r - empty.r) * num) / 255);
+    Uint32 g = empty.g + (((solid.g - empty.g) * num) / 255);
+    Uint32 b = empty.b + (((solid.b - empty.b) * num) / 255);
+    return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+/* Uploads the texels of blocks bx0..bx1, by0..by1 (inclusive, inside the tile) */
+void lod_upload(lod_map* lod, world* w, int l, lod_tile* tile, int tx, int ty, cell_box blocks, rgb empty, rgb solid) {
+    int width = blocks.x1 - blocks.x0 + 1;
+    SDL_Rect rect = {blocks.x0 - (tx * LOD_TILE_TEXELS), blocks.y0 - (ty * LOD_TILE_TEXELS), width, blocks.y1 - blocks.y0 + 1};
+    for (int by = blocks.y0; by <= blocks.y1; by++) {
+        for (int bx = blocks.x0; bx <= blocks.x1; bx++) {
+            lod->texels[((by - blocks.y0) * width) + (bx - blocks.x0)] = lod_texel(lod, w, l, bx, by, empty, solid);
+        }
+    }
+    SDL_UpdateTexture(tile->texture, &rect, lod->texels, width * sizeof(Uint32));
+}
+
+/* Returns the tile's texture, built on first use and patched where the map changed since */
+SDL_Texture* lod_prepare_tile(lod_map* lod, SDL_Renderer* renderer, world* w, int l, int tx, int ty, rgb empty, rgb solid) {
+    lod_tile* tile = &lod->tiles[l][(ty * lod->tiles_x[l]) + tx];
+    int f = lod_factors[l];
+    cell_box blocks = {
+        tx * LOD_TILE_TEXELS, ty * LOD_TILE_TEXELS,
+        SDL_min((tx + 1) * LOD_TILE_TEXELS, lod->blocks_x[l]) - 1, SDL_min((ty + 1) * LOD_TILE_TEXELS, lod->blocks_y[l]) - 1
+    };
+
+    if (!tile->texture) {
+        tile->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, LOD_TILE_TEXELS, LOD_TILE_TEXELS);
+        if (!tile->texture) return NULL;
+        lod_upload(lod, w, l, tile, tx, ty, blocks, empty, solid);
+        tile->gen = w->dirty.gen;
+        return tile->texture;
+    }
+    if (tile->gen == w->dirty.gen) return tile->texture;
+
+    dirty_tracker* t = &w->dirty;
+    int shift = DIRTY_REGION_SHIFT;
+    for (int ry = (blocks.y0 * f) >> shift; ry <= SDL_min((((blocks.y1 + 1) * f) - 1) >> shift, t->regions_y - 1); ry++) {
+        for (int rx = (blocks.x0 * f) >> shift; rx <= SDL_min((((blocks.x1 + 1) * f) - 1) >> shift, t->regions_x - 1); rx++) {
+            if (t->region_gens[(ry * t->regions_x) + rx] <= tile->gen) continue;
+            cell_box region = {
+                SDL_max((rx << shift) / f, blocks.x0), SDL_max((ry << shift) / f, blocks.y0),
+                SDL_min((((rx + 1) << shift) - 1) / f, blocks.x1), SDL_min((((ry + 1) << shift) - 1) / f, blocks.y1)
+            };
+            lod_upload(lod, w, l, tile, tx, ty, region, empty, solid);
+        }
+    }
+    tile->gen = w->dirty.gen;
+    return tile->texture;
+}
+
+/* Draws the visible tiles at the level fitting the zoom, FALSE when textures can't be made */
+int lod_draw(lod_map* lod, SDL_Renderer* renderer, camera* cam, world* w, rgb empty, rgb solid) {
+    if (lod->failed) return FALSE;
+    lod_sync(lod, w);
+
+    int l = lod_pick_level(cam->zoom_p);
+    int tile_world = LOD_TILE_TEXELS * lod_factors[l] * GRID_SPACING;
+    int view_x1 = cam->x + (WINDOW_WIDTH / cam->zoom_p);
+    int view_y1 = cam->y + (WINDOW_HEIGHT / cam->zoom_p);
+    int tx0 = SDL_max(cam->x / tile_world, 0), tx1 = SDL_min(view_x1 / tile_world, lod->tiles_x[l] - 1);
+    int ty0 = SDL_max(cam->y / tile_world, 0), ty1 = SDL_min(view_y1 / tile_world, lod->tiles_y[l] - 1);
+    lod->level = l;
+
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            SDL_Texture* texture = lod_prepare_tile(lod, renderer, w, l, tx, ty, empty, solid);
+            if (!texture) {
+                lod->failed = TRUE;
+                return FALSE;
+            }
+            int texels_x = SDL_min(LOD_TILE_TEXELS, lod->blocks_x[l] - (tx * LOD_TILE_TEXELS));
+            int texels_y = SDL_min(LOD_TILE_TEXELS, lod->blocks_y[l] - (ty * LOD_TILE_TEXELS));
+            int x0 = round(((tx * tile_world) - cam->x) * cam->zoom_p);
+            int y0 = round(((ty * tile_world) - cam->y) * cam->zoom_p);
+            int x1 = round((((tx * tile_world) + (texels_x * lod_factors[l] * GRID_SPACING)) - cam->x) * cam->zoom_p);
+            int y1 = round((((ty * tile_world) + (texels_y * lod_factors[l] * GRID_SPACING)) - cam->y) * cam->zoom_p);
+            SDL_Rect src = {0, 0, texels_x, texels_y};
+            SDL_Rect dst = {x0, y0, x1 - x0, y1 - y0};
+            SDL_RenderCopy(renderer, texture, &src, &dst);
+        }
+    }
+    return TRUE;
+}
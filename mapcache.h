@@ -0,0 +1,108 @@
+/* Render Caches */
+
+/*
+ * Both caches are built from the render side's world and stay valid until its dirty tracker says
+ * the cells they were built from changed, then only the affected rows or columns are redone.
+ */
+
+/* Map View Geometry */
+typedef struct cell_run {
+    int start;
+    int length;
+    int solid;
+} cell_run;
+
+/* Each grid row merged into runs of equal cells, so the map view draws a row as a few rects */
+typedef struct map_view_cache {
+    int grid_length;
+    int grid_height;
+    Uint32 gen;
+    int* num_runs; /* Per row */
+    cell_run* runs; /* grid_length slots per row */
+} map_view_cache;
+
+void map_view_build_row(map_view_cache* mv, world* w, int row) {
+    cell_run* runs = &mv->runs[row * mv->grid_length];
+    int n = 0;
+    for (int col = 0; col < mv->grid_length; col++) {
+        int solid = get_grid_bool(w, col, row);
+        if (n && runs[n - 1].solid == solid) runs[n - 1].length++;
+        else runs[n++] = (cell_run) {col, 1, solid};
+    }
+    mv->num_runs[row] = n;
+}
+
+void map_view_free(map_view_cache* mv) {
+    free(mv->num_runs);
+    free(mv->runs);
+    mv->num_runs = NULL;
+    mv->runs = NULL;
+}
+
+void map_view_sync(map_view_cache* mv, world* w) {
+    int rebuild_all = !mv->runs || mv->grid_length != w->grid_length || mv->grid_height != w->grid_height;
+
+    if (rebuild_all) {
+        map_view_free(mv);
+        mv->grid_length = w->grid_length;
+        mv->grid_height = w->grid_height;
+        mv->num_runs = calloc(w->grid_height, sizeof(*mv->num_runs));
+        mv->runs = calloc(w->grid_length * w->grid_height, sizeof(*mv->runs));
+    } else if (mv->gen == w->dirty.gen) return;
+
+    for (int band = 0; band < w->grid_height; band += 1 << DIRTY_REGION_SHIFT) {
+        int last = SDL_min(band + (1 << DIRTY_REGION_SHIFT), w->grid_height) - 1;
+        if (!rebuild_all && !dirty_rect_since(&w->dirty, 0, band, w->grid_length - 1, last, mv->gen)) continue;
+        for (int row = band; row <= last; row++) map_view_build_row(mv, w, row);
+    }
+    mv->gen = w->dirty.gen;
+}
+
+/* Column Hits */
+typedef struct column_pose {
+#if FIXED_MATH
+    fixed x;
+    fixed y;
+    fixed angle;
+#else
+    int x;
+    int y;
+    float angle;
+#endif
+} column_pose;
+
+/* Last frame's ray hits, reused while the player holds still and the map around each ray is unchanged */
+typedef struct column_cache {
+    int valid;
+    Uint32 gen;
+    column_pose pose;
+#if FIXED_MATH
+    fx_xy hits[WINDOW_WIDTH];
+#else
+    xy hits[WINDOW_WIDTH];
+#endif
+} column_cache;
+
+int column_cache_matches(column_cache* cc, column_pose pose) {
+    return cc->valid && cc->pose.x == pose.x && cc->pose.y == pose.y && cc->pose.angle == pose.angle;
+}
+
+/* A changed cell can only move a hit if it lies in the box around the ray, grown a cell for the far side test */
+int column_stale(column_cache* cc, world* w, int ray_i) {
+    if (cc->gen == w->dirty.gen) return FALSE;
+#if FIXED_MATH
+    int x0 = fx_int(cc->pose.x) >> GRID_SHIFT, y0 = fx_int(cc->pose.y) >> GRID_SHIFT;
+    int x1 = fx_int(cc->hits[ray_i].x) >> GRID_SHIFT, y1 = fx_int(cc->hits[ray_i].y) >> GRID_SHIFT;
+#else
+    int x0 = cc->pose.x >> GRID_SHIFT, y0 = cc->pose.y >> GRID_SHIFT;
+    int x1 = cc->hits[ray_i].x >> GRID_SHIFT, y1 = cc->hits[ray_i].y >> GRID_SHIFT;
+#endif
+    return dirty_rect_since(&w->dirty, SDL_min(x0, x1) - 1, SDL_min(y0, y1) - 1, SDL_max(x0, x1) + 1, SDL_max(y0, y1) + 1, cc->gen);
+}
+
+/* Every column has been cast or checked for this pose and the map as it is now */
+void column_cache_commit(column_cache* cc, world* w, column_pose pose) {
+    cc->valid = TRUE;
+    cc->pose = pose;
+    cc->gen = w->dirty.gen;
+}
@@ -0,0 +1,130 @@
+/* Multi-View Casting */
+
+/*
+ * Split screen, spectator cameras and low resolution bot vision all need several first person views
+ * of one world per frame. A view batch lines up every view's columns as one list of rays and splits
+ * it over threads once, so each extra view costs its columns and nothing more. All threads read the
+ * same grid, which must hold still while the batch casts. Maps with a wall layer cast every column's
+ * spans instead of its single hit.
+ */
+#define MAX_VIEWS 16
+#define VIEW_MAX_THREADS 16
+
+typedef struct view_camera {
+    column_pose pose; /* Ray origin and facing */
+    SDL_Rect viewport; /* Where the view goes in the framebuffer */
+    int columns; /* Rays across the view, each drawn viewport.w / columns wide */
+} view_camera;
+
+typedef struct view_batch {
+    int num_views;
+    view_camera views[MAX_VIEWS];
+    int first_ray[MAX_VIEWS + 1]; /* Each view's columns start here in hits, the last entry is the total */
+    int hits_cap;
+#if FIXED_MATH
+    fx_xy* hits;
+#else
+    xy* hits;
+#endif
+    wall_span* spans; /* MAX_WALL_SPANS per ray, cast instead of hits on maps with a wall layer */
+    Uint8* num_spans; /* NULL when the last cast was of single hits */
+} view_batch;
+
+typedef struct view_batch_job {
+    view_batch* batch;
+    world* w;
+    int first;
+    int last;
+    ray_stats* ray_counts; /* NULL when the caller isn't counting */
+    ray_stats thread_counts;
+} view_batch_job;
+
+void view_batch_free(view_batch* b) {
+    free(b->hits);
+    free(b->spans);
+    free(b->num_spans);
+    b->hits = NULL;
+    b->spans = NULL;
+    b->num_spans = NULL;
+    b->hits_cap = 0;
+    b->num_views = 0;
+}
+
+/* Returns the view's index, or -1 when the batch is full */
+int view_batch_add(view_batch* b, column_pose pose, SDL_Rect viewport, int columns) {
+    if (b->num_views == MAX_VIEWS || columns < 1) return -1;
+    b->views[b->num_views] = (view_camera) {pose, viewport, columns};
+    return b->num_views++;
+}
+
+#if FIXED_MATH
+fixed view_ray_angle(view_camera* v, int column) {
+    return fx_wrap_angle((v->pose.angle - (FX_FOV / 2)) + ((FX_FOV * column) / v->columns));
+}
+#else
+float view_ray_angle(view_camera* v, int column) {
+    float ray_angle = (v->pose.angle - (FOV / 2)) + ((FOV / v->columns) * column);
+    if (ray_angle < 0) ray_angle += M_PI * 2;
+    else if (ray_angle >= M_PI * 2) ray_angle -= M_PI * 2;
+    return ray_angle;
+}
+#endif
+
+int view_batch_thread(void* data) {
+    view_batch_job* job = data;
+    view_batch* b = job->batch;
+    int v = 0;
+
+    if (job->ray_counts) ray_stats_bind(&job->thread_counts);
+    for (int i = job->first; i < job->last; i++) {
+        while (i >= b->first_ray[v + 1]) v++;
+        view_camera* view = &b->views[v];
+        if (b->num_spans) {
+            b->num_spans[i] = raycast_spans(job->w, view->pose.x, view->pose.y, view_ray_angle(view, i - b->first_ray[v]), &b->spans[i * MAX_WALL_SPANS]);
+        } else b->hits[i] = raycast(job->w, view->pose.x, view->pose.y, view_ray_angle(view, i - b->first_ray[v]), FALSE);
+    }
+    ray_stats_bind(NULL);
+    return 0;
+}
+
+/* Casts every column of every view, split evenly over up to num_threads threads */
+void view_batch_cast(view_batch* b, world* w, int num_threads, ray_stats* ray_counts) {
+    view_batch_job jobs[VIEW_MAX_THREADS];
+    SDL_Thread* threads[VIEW_MAX_THREADS];
+
+    b->first_ray[0] = 0;
+    for (int v = 0; v < b->num_views; v++) b->first_ray[v + 1] = b->first_ray[v] + b->views[v].columns;
+    int num_rays = b->first_ray[b->num_views];
+    if (num_rays > b->hits_cap) {
+        free(b->hits);
+        free(b->spans);
+        free(b->num_spans);
+        b->spans = NULL;
+        b->num_spans = NULL;
+        b->hits_cap = num_rays;
+        b->hits = malloc(num_rays * sizeof(*b->hits));
+    }
+    if (w->wall_layer && !b->spans) {
+        b->spans = malloc(b->hits_cap * MAX_WALL_SPANS * sizeof(*b->spans));
+        b->num_spans = malloc(b->hits_cap);
+    } else if (!w->wall_layer) {
+        free(b->spans);
+        free(b->num_spans);
+        b->spans = NULL;
+        b->num_spans = NULL;
+    }
+    num_threads = SDL_max(SDL_min(SDL_min(num_threads, VIEW_MAX_THREADS), num_rays), 1);
+
+    for (int t = 0; t < num_threads; t++) {
+        jobs[t] = (view_batch_job) {b, w, (num_rays * t) / num_threads, (num_rays * (t + 1)) / num_threads, ray_counts};
+        threads[t] = t == 0 ? NULL : SDL_CreateThread(view_batch_thread, "view batch", &jobs[t]);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        if (threads[t]) SDL_WaitThread(threads[t], NULL);
+        else view_batch_thread(&jobs[t]);
+        if (ray_counts) {
+            ray_stats_merge(ray_counts, &jobs[t].thread_counts);
+            ray_stats_free(&jobs[t].thread_counts);
+        }
+    }
+}
@@ -0,0 +1,165 @@
+/* Frame Pacing */
+
+/*
+ * Frames are paced on the performance counter rather than SDL_GetTicks, whose whole milliseconds made
+ * the 60 FPS target 16 ms, really 62.5 Hz. The pacer sleeps until just short of each deadline and spins
+ * the rest, as SDL_Delay can wake a couple of milliseconds late. Deadlines advance by exact periods so a
+ * late frame doesn't push back the ones after it. Recent frame times are kept to report their spread.
+ */
+#define PACE_UNCAPPED 0 /* As fast as frames render */
+#define PACE_FIXED 1 /* Sleep and spin to the target rate */
+#define PACE_VSYNC 2 /* Present waits for the display's refresh */
+#define PACE_ADAPTIVE 3 /* Fixed pacing at the refresh rate, dropping to a fraction of it while frames can't keep up */
+#define PACE_MODES 4
+
+#define PACE_HISTORY 240 /* Frame times kept for the spread */
+#define PACE_MIN_SPIN_MS 0.5 /* Always spun, however punctual sleeps have been */
+#define PACE_MAX_SPIN_MS 4.0
+#define PACE_VSYNC_LATE 1.5 /* Refresh periods a vsynced frame may take before it counts as missed */
+#define PACE_ADAPT_MISSES 3 /* Misses in a row that drop adaptive pacing to the next fraction */
+#define PACE_ADAPT_RECOVER 120 /* Frames in a row with headroom before it tries the faster rate again */
+#define PACE_ADAPT_HEADROOM 0.75 /* Share of the faster period a frame's work must fit in to count */
+#define PACE_ADAPT_MAX_DIVISOR 4
+
+const char* pace_mode_names[PACE_MODES] = {"uncapped", "fixed", "vsync", "adaptive"};
+
+typedef struct frame_pacer {
+    int mode;
+    double target_hz; /* Fixed pacing's rate */
+    double refresh_hz; /* The display's, for vsync and adaptive pacing */
+    int divisor; /* Adaptive pacing runs at refresh_hz / divisor */
+    Uint64 freq;
+    Uint64 period; /* Counter ticks per frame while pacing */
+    Uint64 deadline; /* When the next frame should start */
+    Uint64 last; /* When the last frame started */
+    Uint64 carry; /* Ticks not handed out yet as whole milliseconds of delta */
+    double spin_ms; /* How long before a deadline sleeping stops, learned from how late sleeps wake */
+    int late_streak;
+    int headroom_streak;
+
+    float history[PACE_HISTORY]; /* Milliseconds between frame starts */
+    int history_next;
+    int history_len;
+    int frames; /* Since the stats were last reset */
+    int missed;
+} frame_pacer;
+
+int pace_mode_from_name(const char* name) {
+    for (int i = 0; i < PACE_MODES; i++) {
+        if (strcmp(name, pace_mode_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+/* Frames per second the pacer aims for, 0 when uncapped */
+double pacer_rate(frame_pacer* p) {
+    if (p->mode == PACE_FIXED) return p->target_hz;
+    if (p->mode == PACE_VSYNC) return p->refresh_hz;
+    if (p->mode == PACE_ADAPTIVE) return p->refresh_hz / p->divisor;
+    return 0;
+}
+
+void pacer_set_mode(frame_pacer* p, int mode, double target_hz) {
+    p->mode = mode;
+    if (target_hz > 0) p->target_hz = target_hz;
+    p->divisor = 1;
+    p->late_streak = 0;
+    p->headroom_streak = 0;
+    double rate = pacer_rate(p);
+    p->period = rate > 0 ? p->freq / rate : 0;
+    p->deadline = SDL_GetPerformanceCounter() + p->period;
+}
+
+void pacer_init(frame_pacer* p, int mode, double target_hz, double refresh_hz) {
+    memset(p, 0, sizeof(*p));
+    p->freq = SDL_GetPerformanceFrequency();
+    p->refresh_hz = refresh_hz > 0 ? refresh_hz : target_hz;
+    p->spin_ms = PACE_MAX_SPIN_MS / 2;
+    p->last = SDL_GetPerformanceCounter();
+    pacer_set_mode(p, mode, target_hz);
+}
+
+void pacer_reset_stats(frame_pacer* p) {
+    p->history_next = 0;
+    p->history_len = 0;
+    p->frames = 0;
+    p->missed = 0;
+}
+
+/* Sleeps to spin_ms short of the deadline, then spins, learning how late sleeps wake */
+void pacer_sleep_until(frame_pacer* p, Uint64 deadline) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (now >= deadline) return; /* Passed since the caller looked, the unsigned difference would wrap */
+    double remaining_ms = (double) (Sint64) (deadline - now) * 1000 / p->freq;
+    if (remaining_ms > p->spin_ms) {
+        Uint32 sleep_ms = remaining_ms - p->spin_ms;
+        SDL_Delay(sleep_ms);
+        double overshoot = ((double) (SDL_GetPerformanceCounter() - now) * 1000 / p->freq) - sleep_ms;
+        p->spin_ms = SDL_max((p->spin_ms * 0.95) + (overshoot * 0.05), overshoot); /* Jumps up at once, eases back down */
+        p->spin_ms = SDL_min(SDL_max(p->spin_ms, PACE_MIN_SPIN_MS), PACE_MAX_SPIN_MS);
+    }
+    while (SDL_GetPerformanceCounter() < deadline);
+}
+
+/* Adaptive pacing drops to a fraction of the refresh rate while frames miss, and climbs back once they have room */
+void pacer_adapt(frame_pacer* p, int late, Uint64 busy) {
+    if (late) {
+        p->headroom_streak = 0;
+        if (++p->late_streak < PACE_ADAPT_MISSES || p->divisor == PACE_ADAPT_MAX_DIVISOR) return;
+        p->divisor++;
+    } else {
+        p->late_streak = 0;
+        Uint64 faster = p->freq * (p->divisor - 1) / p->refresh_hz;
+        if (p->divisor == 1 || busy > faster * PACE_ADAPT_HEADROOM) {
+            p->headroom_streak = 0;
+            return;
+        }
+        if (++p->headroom_streak < PACE_ADAPT_RECOVER) return;
+        p->divisor--;
+    }
+    p->late_streak = 0;
+    p->headroom_streak = 0;
+    p->period = p->freq * p->divisor / p->refresh_hz;
+}
+
+/* Waits for the next frame's start, returning the milliseconds since the last one for the simulation */
+int pacer_wait(frame_pacer* p) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    Uint64 busy = now - p->last; /* The last frame's work, none of it spent waiting here */
+    int late = FALSE;
+
+    if (p->mode == PACE_FIXED || p->mode == PACE_ADAPTIVE) {
+        late = now > p->deadline;
+        if (p->mode == PACE_ADAPTIVE) pacer_adapt(p, late, busy);
+        if (!late) pacer_sleep_until(p, p->deadline);
+        else if (now - p->deadline > p->period) p->deadline = now; /* A frame or more behind, start over rather than rush to catch up */
+        p->deadline += p->period;
+        now = SDL_GetPerformanceCounter();
+    } else if (p->mode == PACE_VSYNC) {
+        late = busy > p->freq * PACE_VSYNC_LATE / p->refresh_hz;
+    }
+
+    Uint64 elapsed = (now - p->last) + p->carry;
+    int delta_ms = elapsed * 1000 / p->freq;
+    p->carry = elapsed - ((Uint64) delta_ms * p->freq / 1000);
+    p->history[p->history_next] = (double) (now - p->last) * 1000 / p->freq;
+    p->history_next = (p->history_next + 1) % PACE_HISTORY;
+    p->history_len = SDL_min(p->history_len + 1, PACE_HISTORY);
+    p->frames++;
+    p->missed += late;
+    p->last = now;
+    return delta_ms;
+}
+
+/* Mean, standard deviation and worst of the kept frame times */
+void pacer_stats(frame_pacer* p, double* mean, double* deviation, double* worst) {
+    double sum = 0, squares = 0;
+    *worst = 0;
+    for (int i = 0; i < p->history_len; i++) {
+        sum += p->history[i];
+        *worst = SDL_max(*worst, p->history[i]);
+    }
+    *mean = p->history_len ? sum / p->history_len : 0;
+    for (int i = 0; i < p->history_len; i++) squares += (p->history[i] - *mean) * (p->history[i] - *mean);
+    *deviation = p->history_len ? sqrt(squares / p->history_len) : 0;
+}
@@ -0,0 +1,426 @@
+/* Pathfinding */
+
+/*
+ * Jump Point Search over the packed occupancy grid, moving in 8 directions without cutting wall
+ * corners. Straight jumps read 64 cells of a row at a time straight out of grid_enc, together with
+ * the rows either side for forced neighbours. Vertical jumps do the same on a transposed copy of the
+ * grid, kept in step with the dirty tracker. Search state lives in pools, one per thread, reused
+ * between queries without clearing thanks to a per query stamp.
+ */
+#define PATH_STRAIGHT_COST 10
+#define PATH_DIAGONAL_COST 14
+#define PATH_MAX_THREADS 16
+
+typedef struct path_heap_entry {
+    int f;
+    int g;
+    int cell;
+} path_heap_entry;
+
+typedef struct path_pool {
+    int num_cells;
+    Uint32 query; /* Cells whose seen stamp differs have no state yet this query */
+    Uint32* seen;
+    Uint32* closed;
+    int* g;
+    int* parent;
+    path_heap_entry* heap;
+    int heap_len;
+    int heap_cap;
+} path_pool;
+
+typedef struct pathfinder {
+    int grid_length;
+    int grid_height;
+    bool_cont* columns; /* Column x holds cell (x, y) at bit (x * grid_height) + y */
+    size_t columns_bytes;
+    Uint32 gen; /* Dirty tracker generation the columns match */
+    path_pool pools[PATH_MAX_THREADS]; /* pools[0] also serves path_find calls from the owning thread */
+} pathfinder;
+
+typedef struct path_query {
+    int sx;
+    int sy;
+    int gx;
+    int gy;
+    xy* points; /* Caller's buffer for the jump points from start to goal, may be NULL */
+    int max_points;
+    int num_points; /* Set by the search, -1 when there is no path */
+    int cost; /* PATH_STRAIGHT_COST per straight step, PATH_DIAGONAL_COST per diagonal one */
+} path_query;
+
+/* Bit Scanning */
+int lowest_bit64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(v);
+#else
+    int i = 0;
+    while (!(v & 1)) { v >>= 1; i++; }
+    return i;
+#endif
+}
+
+int highest_bit64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(v);
+#else
+    int i = 0;
+    while (v >>= 1) i++;
+    return i;
+#endif
+}
+
+/* 64 bits starting at any bit, bit 0 of the result is the first. Past the end reads as 0 */
+uint64_t load_bits64(const bool_cont* bits, size_t num_bytes, long bit) {
+    size_t byte = bit >> 3;
+    int shift = bit & 7;
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+    if (byte + 9 <= num_bytes) {
+        memcpy(&lo, &bits[byte], sizeof(lo));
+        lo = SDL_SwapLE64(lo);
+        hi = bits[byte + 8];
+    } else {
+        for (int i = 0; i < 8 && byte + i < num_bytes; i++) lo |= (uint64_t) bits[byte + i] << (8 * i);
+    }
+    return shift ? (lo >> shift) | (hi << (64 - shift)) : lo;
+}
+
+/*
+ * Jumps along one line of a bitmap (a grid row, or a column of the transposed grid) from pos towards
+ * dir. Returns the position of the first jump point, which is the goal or a cell that has a forced
+ * neighbour on the line before or after. Returns -1 when a wall or the map edge comes first.
+ */
+int scan_line(const bool_cont* bits, size_t num_bytes, int line_len, int num_lines, int line, int pos, int dir, int goal) {
+    long base = (long) line * line_len;
+    int has_before = line > 0;
+    int has_after = line < num_lines - 1;
+
+    if (dir > 0) {
+        while (TRUE) {
+            int span = line_len - pos; /* Cells from pos to the end of the line */
+            if (span <= 1) return -1;
+            uint64_t off_line = span >= 64 ? 0 : ~(uint64_t) 0 << span;
+            uint64_t walls = load_bits64(bits, num_bytes, base + pos) | off_line;
+            uint64_t before = has_before ? load_bits64(bits, num_bytes, base - line_len + pos) : ~(uint64_t) 0;
+            uint64_t after = has_after ? load_bits64(bits, num_bytes, base + line_len + pos) : ~(uint64_t) 0;
+            /* A side cell opening up right after a blocked one forces a turn there */
+            uint64_t stops = walls | (~before & (before << 1)) | (~after & (after << 1));
+            if (goal > pos && goal - pos < 64) stops |= (uint64_t) 1 << (goal - pos);
+            stops &= ~(uint64_t) 1;
+
+            if (stops) {
+                int k = lowest_bit64(stops);
+                return (walls >> k) & 1 ? -1 : pos + k;
+            }
+            pos += 63;
+        }
+    } else {
+        while (pos > 0) {
+            int start = pos > 63 ? pos - 63 : 0;
+            int top = pos - start;
+            uint64_t walls = load_bits64(bits, num_bytes, base + start);
+            uint64_t before = has_before ? load_bits64(bits, num_bytes, base - line_len + start) : ~(uint64_t) 0;
+            uint64_t after = has_after ? load_bits64(bits, num_bytes, base + line_len + start) : ~(uint64_t) 0;
+            uint64_t stops = walls | (~before & (before >> 1)) | (~after & (after >> 1));
+            if (goal >= start && goal < pos) stops |= (uint64_t) 1 << (goal - start);
+            stops &= ((uint64_t) 1 << top) - 1;
+
+            if (stops) {
+                int k = highest_bit64(stops);
+                return (walls >> k) & 1 ? -1 : start + k;
+            }
+            pos = start;
+        }
+        return -1;
+    }
+}
+
+/* Pools */
+void path_pool_free(path_pool* pool) {
+    free(pool->seen);
+    free(pool->closed);
+    free(pool->g);
+    free(pool->parent);
+    free(pool->heap);
+    memset(pool, 0, sizeof(*pool));
+}
+
+/* Readies the pool for a query over num_cells cells, FALSE when its arrays can't be allocated */
+int path_pool_begin(path_pool* pool, int num_cells) {
+    if (pool->num_cells != num_cells) {
+        path_pool_free(pool);
+        pool->seen = calloc(num_cells, sizeof(*pool->seen));
+        pool->closed = calloc(num_cells, sizeof(*pool->closed));
+        pool->g = malloc(num_cells * sizeof(*pool->g));
+        pool->parent = malloc(num_cells * sizeof(*pool->parent));
+        if (!pool->seen || !pool->closed || !pool->g || !pool->parent) {
+            path_pool_free(pool); /* Left empty, the next query tries again */
+            return FALSE;
+        }
+        pool->num_cells = num_cells;
+    }
+    if (++pool->query == 0) { /* Stamps wrapped, old ones could match again */
+        memset(pool->seen, 0, num_cells * sizeof(*pool->seen));
+        memset(pool->closed, 0, num_cells * sizeof(*pool->closed));
+        pool->query = 1;
+    }
+    pool->heap_len = 0;
+    return TRUE;
+}
+
+/* FALSE when the heap is full and can't grow, it keeps what it had */
+int path_heap_push(path_pool* pool, path_heap_entry e) {
+    if (pool->heap_len == pool->heap_cap) {
+        int cap = pool->heap_cap ? pool->heap_cap * 2 : 256;
+        path_heap_entry* heap = realloc(pool->heap, cap * sizeof(*heap));
+        if (!heap) return FALSE;
+        pool->heap = heap;
+        pool->heap_cap = cap;
+    }
+    int i = pool->heap_len++;
+    while (i > 0 && pool->heap[(i - 1) / 2].f > e.f) {
+        pool->heap[i] = pool->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    pool->heap[i] = e;
+    return TRUE;
+}
+
+path_heap_entry path_heap_pop(path_pool* pool) {
+    path_heap_entry top = pool->heap[0];
+    path_heap_entry last = pool->heap[--pool->heap_len];
+    int i = 0;
+    while (TRUE) {
+        int child = (i * 2) + 1;
+        if (child >= pool->heap_len) break;
+        if (child + 1 < pool->heap_len && pool->heap[child + 1].f < pool->heap[child].f) child++;
+        if (pool->heap[child].f >= last.f) break;
+        pool->heap[i] = pool->heap[child];
+        i = child;
+    }
+    if (pool->heap_len) pool->heap[i] = last;
+    return top;
+}
+
+/* Pathfinder */
+void pathfinder_init(pathfinder* pf) {
+    memset(pf, 0, sizeof(*pf));
+}
+
+void pathfinder_free(pathfinder* pf) {
+    free(pf->columns);
+    for (int i = 0; i < PATH_MAX_THREADS; i++) path_pool_free(&pf->pools[i]);
+    pathfinder_init(pf);
+}
+
+void transpose_cell(pathfinder* pf, world* w, int x, int y) {
+    bit_assign(&pf->columns[((x * pf->grid_height) + y) >> BOOL_CONT_SHIFT], ((x * pf->grid_height) + y) & (BOOL_CONT_BITS - 1), get_grid_bool(w, x, y));
+}
+
+/* Brings the transposed grid up to the world, only redoing dirty regions. Never call during a search */
+void pathfinder_sync(pathfinder* pf, world* w) {
+    if (!pf->columns || pf->grid_length != w->grid_length || pf->grid_height != w->grid_height) {
+        free(pf->columns);
+        pf->grid_length = w->grid_length;
+        pf->grid_height = w->grid_height;
+        pf->columns_bytes = grid_enc_size(w->grid_height, w->grid_length);
+        pf->columns = calloc(1, pf->columns_bytes);
+        if (!pf->columns) return; /* Searches find nothing until a sync manages it */
+        for (int y = 0; y < w->grid_height; y++) {
+            for (int x = 0; x < w->grid_length; x++) transpose_cell(pf, w, x, y);
+        }
+        pf->gen = w->dirty.gen;
+        return;
+    }
+    if (pf->gen == w->dirty.gen) return;
+
+    dirty_tracker* t = &w->dirty;
+    int region = 1 << DIRTY_REGION_SHIFT;
+    for (int ry = 0; ry < t->regions_y; ry++) {
+        for (int rx = 0; rx < t->regions_x; rx++) {
+            if (t->region_gens[(ry * t->regions_x) + rx] <= pf->gen) continue;
+            for (int y = ry * region; y < SDL_min((ry + 1) * region, w->grid_height); y++) {
+                for (int x = rx * region; x < SDL_min((rx + 1) * region, w->grid_length); x++) transpose_cell(pf, w, x, y);
+            }
+        }
+    }
+    pf->gen = w->dirty.gen;
+}
+
+int path_walkable(world* w, int x, int y) {
+    return in_grid(w, x, y) && !get_grid_bool(w, x, y);
+}
+
+int octile(int x0, int y0, int x1, int y1) {
+    int dx = abs(x1 - x0), dy = abs(y1 - y0);
+    return (PATH_STRAIGHT_COST * (dx + dy)) + ((PATH_DIAGONAL_COST - (2 * PATH_STRAIGHT_COST)) * SDL_min(dx, dy));
+}
+
+/* Straight jump from (x, y), exactly one of dx and dy is set */
+int jump_straight(pathfinder* pf, world* w, int x, int y, int dx, int dy, int gx, int gy, int* jx, int* jy) {
+    if (dy == 0) {
+        int c = scan_line(w->grid_enc, grid_enc_size(w->grid_length, w->grid_height), w->grid_length, w->grid_height, y, x, dx, gy == y ? gx : -1);
+        *jx = c; *jy = y;
+        return c != -1;
+    }
+    int c = scan_line(pf->columns, pf->columns_bytes, pf->grid_height, pf->grid_length, x, y, dy, gx == x ? gy : -1);
+    *jx = x; *jy = c;
+    return c != -1;
+}
+
+/* Jump from (x, y) towards (dx, dy), diagonals step a cell at a time and stop where a straight jump finds something */
+int jump(pathfinder* pf, world* w, int x, int y, int dx, int dy, int gx, int gy, int* jx, int* jy) {
+    if (!dx || !dy) return jump_straight(pf, w, x, y, dx, dy, gx, gy, jx, jy);
+    while (TRUE) {
+        if (!path_walkable(w, x + dx, y) || !path_walkable(w, x, y + dy)) return FALSE; /* No corner cutting */
+        x += dx;
+        y += dy;
+        if (!path_walkable(w, x, y)) return FALSE;
+        int sx, sy;
+        if (
+            (x == gx && y == gy) ||
+            jump_straight(pf, w, x, y, dx, 0, gx, gy, &sx, &sy) ||
+            jump_straight(pf, w, x, y, 0, dy, gx, gy, &sx, &sy)
+        ) {
+            *jx = x; *jy = y;
+            return TRUE;
+        }
+    }
+}
+
+/* Directions worth jumping in from a cell reached travelling (dx, dy), or all of them from the start */
+int path_directions(world* w, int x, int y, int dx, int dy, int dirs[8][2]) {
+    int n = 0;
+    if (!dx && !dy) {
+        for (int ddy = -1; ddy <= 1; ddy++) {
+            for (int ddx = -1; ddx <= 1; ddx++) {
+                if (!ddx && !ddy) continue;
+                if (ddx && ddy && !(path_walkable(w, x + ddx, y) && path_walkable(w, x, y + ddy))) continue;
+                if (!path_walkable(w, x + ddx, y + ddy)) continue;
+                dirs[n][0] = ddx; dirs[n++][1] = ddy;
+            }
+        }
+    } else if (dx && dy) {
+        int vertical = path_walkable(w, x, y + dy);
+        int horizontal = path_walkable(w, x + dx, y);
+        if (vertical) { dirs[n][0] = 0; dirs[n++][1] = dy; }
+        if (horizontal) { dirs[n][0] = dx; dirs[n++][1] = 0; }
+        if (vertical && horizontal) { dirs[n][0] = dx; dirs[n++][1] = dy; }
+    } else if (dx) {
+        int next = path_walkable(w, x + dx, y);
+        int up = path_walkable(w, x, y - 1);
+        int down = path_walkable(w, x, y + 1);
+        if (next) {
+            dirs[n][0] = dx; dirs[n++][1] = 0;
+            if (up) { dirs[n][0] = dx; dirs[n++][1] = -1; }
+            if (down) { dirs[n][0] = dx; dirs[n++][1] = 1; }
+        }
+        if (up) { dirs[n][0] = 0; dirs[n++][1] = -1; }
+        if (down) { dirs[n][0] = 0; dirs[n++][1] = 1; }
+    } else {
+        int next = path_walkable(w, x, y + dy);
+        int left = path_walkable(w, x - 1, y);
+        int right = path_walkable(w, x + 1, y);
+        if (next) {
+            dirs[n][0] = 0; dirs[n++][1] = dy;
+            if (left) { dirs[n][0] = -1; dirs[n++][1] = dy; }
+            if (right) { dirs[n][0] = 1; dirs[n++][1] = dy; }
+        }
+        if (left) { dirs[n][0] = -1; dirs[n++][1] = 0; }
+        if (right) { dirs[n][0] = 1; dirs[n++][1] = 0; }
+    }
+    return n;
+}
+
+/*
+ * Searches one query with the given pool, the pathfinder must be synced to w. Running out of memory
+ * leaves num_points at -1, like finding no path.
+ */
+void path_find(pathfinder* pf, path_pool* pool, world* w, path_query* q) {
+    int len = w->grid_length;
+    q->num_points = -1;
+    q->cost = 0;
+    if (!pf->columns || !path_walkable(w, q->sx, q->sy) || !path_walkable(w, q->gx, q->gy)) return;
+    if (!path_pool_begin(pool, len * w->grid_height)) return;
+    int start = (q->sy * len) + q->sx;
+    int goal = (q->gy * len) + q->gx;
+    pool->seen[start] = pool->query;
+    pool->g[start] = 0;
+    pool->parent[start] = -1;
+    if (!path_heap_push(pool, (path_heap_entry) {octile(q->sx, q->sy, q->gx, q->gy), 0, start})) return;
+
+    while (pool->heap_len) {
+        path_heap_entry e = path_heap_pop(pool);
+        if (pool->closed[e.cell] == pool->query || e.g != pool->g[e.cell]) continue; /* Stale entry */
+        pool->closed[e.cell] = pool->query;
+
+        if (e.cell == goal) {
+            int count = 0;
+            for (int c = goal; c != -1; c = pool->parent[c]) count++;
+            int i = count;
+            for (int c = goal; c != -1; c = pool->parent[c]) {
+                if (--i < q->max_points && q->points) q->points[i] = (xy) {c % len, c / len};
+            }
+            q->num_points = count;
+            q->cost = e.g;
+            return;
+        }
+
+        int x = e.cell % len, y = e.cell / len;
+        int dx = 0, dy = 0;
+        if (pool->parent[e.cell] != -1) {
+            int px = pool->parent[e.cell] % len, py = pool->parent[e.cell] / len;
+            dx = (x > px) - (x < px);
+            dy = (y > py) - (y < py);
+        }
+
+        int dirs[8][2];
+        int num_dirs = path_directions(w, x, y, dx, dy, dirs);
+        for (int d = 0; d < num_dirs; d++) {
+            int jx, jy;
+            if (!jump(pf, w, x, y, dirs[d][0], dirs[d][1], q->gx, q->gy, &jx, &jy)) continue;
+            int cell = (jy * len) + jx;
+            if (pool->closed[cell] == pool->query) continue;
+            int g = e.g + octile(x, y, jx, jy);
+            if (pool->seen[cell] == pool->query && g >= pool->g[cell]) continue;
+            pool->seen[cell] = pool->query;
+            pool->g[cell] = g;
+            pool->parent[cell] = e.cell;
+            if (!path_heap_push(pool, (path_heap_entry) {g + octile(jx, jy, q->gx, q->gy), g, cell})) return;
+        }
+    }
+}
+
+/* Batches */
+typedef struct path_batch_job {
+    pathfinder* pf;
+    path_pool* pool;
+    world* w;
+    path_query* queries;
+    int num_queries;
+} path_batch_job;
+
+int path_batch_thread(void* data) {
+    path_batch_job* job = data;
+    for (int i = 0; i < job->num_queries; i++) path_find(job->pf, job->pool, job->w, &job->queries[i]);
+    return 0;
+}
+
+/* Splits the queries over up to num_threads threads, each with its own pool. The world must hold still */
+void path_batch(pathfinder* pf, world* w, path_query* queries, int num_queries, int num_threads) {
+    path_batch_job jobs[PATH_MAX_THREADS];
+    SDL_Thread* threads[PATH_MAX_THREADS];
+    num_threads = SDL_max(SDL_min(SDL_min(num_threads, PATH_MAX_THREADS), num_queries), 1);
+
+    pathfinder_sync(pf, w);
+    for (int t = 0; t < num_threads; t++) {
+        int first = (num_queries * t) / num_threads;
+        jobs[t] = (path_batch_job) {pf, &pf->pools[t], w, &queries[first], ((num_queries * (t + 1)) / num_threads) - first};
+        threads[t] = t == 0 ? NULL : SDL_CreateThread(path_batch_thread, "path batch", &jobs[t]);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        if (threads[t]) SDL_WaitThread(threads[t], NULL);
+        else path_batch_thread(&jobs[t]);
+    }
+}
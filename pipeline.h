@@ -0,0 +1,135 @@
+/* Simulation To Render Pipeline */
+
+/*
+ * The simulation thread steps the game world and publishes a frame snapshot after every tick. The
+ * render side copies the newest snapshot into its own view world, so rendering never reads state the
+ * simulation is writing. Snapshots rotate through three slots: the one being written, the newest ready
+ * one, and the one being drawn, handed over with a single atomic exchange.
+ */
+#define SNAPSHOT_SLOTS 3
+#define SNAPSHOT_FRESH 0x4 /* Set on the ready slot index until the render side takes it */
+#define SNAPSHOT_MAX_TRAIL 64
+#define SNAPSHOT_MAX_DIRTY MAX_CHANGED_CELLS
+
+/* Held keys for the next simulation ticks, -1, 0 or 1 each */
+typedef struct player_controls {
+    char horizontal;
+    char vertical;
+    char rotation;
+    int reset; /* One shot, cleared by the tick that resets the player */
+} player_controls;
+
+typedef struct snapshot_point {
+    int x;
+    int y;
+    rgb color;
+} snapshot_point;
+
+typedef struct frame_snapshot {
+    int frame;
+    player player;
+    int num_trail;
+    snapshot_point trail[SNAPSHOT_MAX_TRAIL];
+    int num_dirty;
+    grid_cell_change dirty[SNAPSHOT_MAX_DIRTY];
+    int grid_resync; /* Too many cells changed, the render side copies the whole grid instead */
+} frame_snapshot;
+
+typedef struct frame_pipeline {
+    world* w; /* Owned by the simulation, only touched with sim_lock held */
+    SDL_mutex* sim_lock;
+    player_controls controls;
+    int paused; /* Held by the console, the render side runs any requested steps itself */
+    int steps;
+    int frame;
+    Uint64 sim_time; /* Performance counter ticks spent simulating, for the console's profile */
+    int sim_ticks;
+
+    frame_snapshot slots[SNAPSHOT_SLOTS];
+    int back; /* Simulation's slot */
+    int front; /* Render side's slot */
+    int keep_dirty; /* The last published snapshot was never taken, carry its dirty cells over */
+    SDL_atomic_t ready; /* Slot index, with SNAPSHOT_FRESH when it holds an unseen frame */
+
+    SDL_Thread* thread; /* NULL when the simulation runs inline on the render thread */
+    SDL_atomic_t running;
+} frame_pipeline;
+
+void pipeline_init(frame_pipeline* pipe, world* w) {
+    memset(pipe, 0, sizeof(*pipe));
+    pipe->w = w;
+    pipe->sim_lock = SDL_CreateMutex();
+    pipe->back = 0;
+    pipe->front = 1;
+    SDL_AtomicSet(&pipe->ready, 2);
+    clear_changed_cells(w);
+}
+
+void pipeline_free(frame_pipeline* pipe) {
+    SDL_DestroyMutex(pipe->sim_lock);
+    pipe->sim_lock = NULL;
+}
+
+/* Copies everything the renderer needs out of the world and takes its changed cells */
+void snapshot_capture(frame_snapshot* snap, world* w, int frame, int keep_dirty) {
+    snap->frame = frame;
+    snap->player = w->player;
+
+    int skip = w->num_fill_dgps - SNAPSHOT_MAX_TRAIL;
+    snap->num_trail = 0;
+    for (struct debug_grid_point* p_i = w->fill_dgp_head; p_i; p_i = p_i->next) {
+        if (skip-- > 0) continue;
+        snap->trail[snap->num_trail++] = (snapshot_point) {p_i->x, p_i->y, p_i->color};
+    }
+
+    if (!keep_dirty) {
+        snap->num_dirty = 0;
+        snap->grid_resync = FALSE;
+    }
+    if (w->changed_cells_overflow) snap->grid_resync = TRUE;
+    for (int i = 0; i < w->num_changed_cells && !snap->grid_resync; i++) {
+        if (snap->num_dirty < SNAPSHOT_MAX_DIRTY) snap->dirty[snap->num_dirty++] = w->changed_cells[i];
+        else snap->grid_resync = TRUE;
+    }
+    clear_changed_cells(w);
+}
+
+/* Simulation side, hands the back slot over as the newest frame */
+void pipeline_publish(frame_pipeline* pipe) {
+    SDL_MemoryBarrierRelease();
+    int prev = SDL_AtomicSet(&pipe->ready, pipe->back | SNAPSHOT_FRESH);
+    pipe->back = prev & ~SNAPSHOT_FRESH;
+    pipe->keep_dirty = prev & SNAPSHOT_FRESH;
+}
+
+/* Render side, returns the newest unseen snapshot or NULL when the simulation hasn't ticked since */
+frame_snapshot* pipeline_acquire(frame_pipeline* pipe) {
+    if (!(SDL_AtomicGet(&pipe->ready) & SNAPSHOT_FRESH)) return NULL;
+    pipe->front = SDL_AtomicSet(&pipe->ready, pipe->front) & ~SNAPSHOT_FRESH;
+    SDL_MemoryBarrierAcquire();
+    return &pipe->slots[pipe->front];
+}
+
+/* Brings the render side's own world up to the snapshot */
+void snapshot_apply(frame_snapshot* snap, world* view, frame_pipeline* pipe) {
+    view->player = snap->player;
+
+    free_dgps(view->fill_dgp_head);
+    view->fill_dgp_head = NULL;
+    view->fill_dgp_tail = NULL;
+    for (int i = 0; i < snap->num_trail; i++) {
+        new_dgp(snap->trail[i].x, snap->trail[i].y, snap->trail[i].color, &view->fill_dgp_head, &view->fill_dgp_tail);
+    }
+    view->num_fill_dgps = snap->num_trail;
+
+    if (snap->grid_resync) {
+        /* May be ahead of the snapshot, the cells changed since then arrive again with later frames */
+        SDL_LockMutex(pipe->sim_lock);
+        world_copy_grid(view, pipe->w);
+        SDL_UnlockMutex(pipe->sim_lock);
+        dirty_mark_all(&view->dirty);
+    } else {
+        for (int i = 0; i < snap->num_dirty; i++) world_apply_change(view, &snap->dirty[i]);
+    }
+    clear_changed_cells(view);
+}
@@ -0,0 +1,103 @@
+/* Ray Traversal Statistics */
+
+/*
+ * With RAY_STATS on, every kernel call counts the grid lines it tested, the grid reads that took, the
+ * lines its losing loop tested past the cell the ray hit, and which cell that was. Counts come from
+ * where and why the loops stopped, so the loops themselves are untouched. Each thread counts into its own
+ * ray_stats, bound with ray_stats_bind, and owners merge them. With RAY_STATS off nothing is compiled in.
+ */
+#define RAY_STATS_BUCKETS 32
+#define RAY_STATS_BUCKET_WIDTH 2 /* Tested lines per histogram bucket, the last one takes the rest */
+
+typedef struct ray_stats {
+    long long rays;
+    long long tests; /* Grid lines tested by both loops */
+    long long lookups; /* Grid reads the loops made */
+    long long overshoot; /* Lines the losing loop tested beyond the hit cell */
+    long long histogram[RAY_STATS_BUCKETS]; /* Rays by lines tested */
+    int frames; /* Counted by whoever casts frames, for per frame figures */
+    int grid_length;
+    int grid_height;
+    Uint32* cell_hits; /* Rays that stopped at each cell */
+} ray_stats;
+
+#if RAY_STATS
+#ifdef _MSC_VER
+#define RAY_STATS_THREAD __declspec(thread)
+#else
+#define RAY_STATS_THREAD _Thread_local
+#endif
+
+RAY_STATS_THREAD ray_stats* ray_stats_sink; /* This thread's counts, NULL counts nothing */
+
+void ray_stats_bind(ray_stats* s) {
+    ray_stats_sink = s;
+}
+#else
+#define ray_stats_bind(s) ((void) 0)
+#endif
+
+void ray_stats_free(ray_stats* s) {
+    free(s->cell_hits);
+    memset(s, 0, sizeof(*s));
+}
+
+/* Clears the counts, keeping the cell array when the map size still fits */
+void ray_stats_reset(ray_stats* s) {
+    Uint32* cell_hits = s->cell_hits;
+    int grid_length = s->grid_length, grid_height = s->grid_height;
+    memset(s, 0, sizeof(*s));
+    s->cell_hits = cell_hits;
+    s->grid_length = grid_length;
+    s->grid_height = grid_height;
+    if (cell_hits) memset(cell_hits, 0, grid_length * grid_height * sizeof(*cell_hits));
+}
+
+/* Sizes the cell counts for the map, dropping them when it changed */
+int ray_stats_fit(ray_stats* s, int grid_length, int grid_height) {
+    if (s->cell_hits && s->grid_length == grid_length && s->grid_height == grid_height) return TRUE;
+    free(s->cell_hits);
+    s->grid_length = grid_length;
+    s->grid_height = grid_height;
+    s->cell_hits = calloc(grid_length * grid_height, sizeof(*s->cell_hits));
+    return s->cell_hits != NULL;
+}
+
+/*
+ * One ray's counts. Lines are grid line indexes along each loop's axis, sx and sy the kernel's step
+ * signs, lookups the grid reads both loops made, and (cell_x, cell_y) the cell on the far side of the
+ * winning line.
+ */
+void ray_stats_record(ray_stats* s, int grid_length, int grid_height, int sx, int sy, int h_tests, int v_tests,
+    int lookups, int h_last, int v_last, int h_wins, int cell_x, int cell_y) {
+    int tests = h_tests + v_tests;
+    int overshoot = h_wins ? (sx > 0 ? v_last - (cell_x + 1) : cell_x - v_last) : (sy > 0 ? h_last - (cell_y + 1) : cell_y - h_last);
+
+    s->rays++;
+    s->tests += tests;
+    s->lookups += lookups;
+    s->overshoot += SDL_max(overshoot, 0);
+    s->histogram[SDL_min(tests / RAY_STATS_BUCKET_WIDTH, RAY_STATS_BUCKETS - 1)]++;
+    if (!ray_stats_fit(s, grid_length, grid_height)) return;
+    cell_x = SDL_min(SDL_max(cell_x, 0), grid_length - 1);
+    cell_y = SDL_min(SDL_max(cell_y, 0), grid_height - 1);
+    s->cell_hits[(cell_y * grid_length) + cell_x]++;
+}
+
+/* Adds src's counts into dst, the cell counts only when both cover the same map */
+void ray_stats_merge(ray_stats* dst, ray_stats* src) {
+    dst->rays += src->rays;
+    dst->tests += src->tests;
+    dst->lookups += src->lookups;
+    dst->overshoot += src->overshoot;
+    dst->frames += src->frames;
+    for (int i = 0; i < RAY_STATS_BUCKETS; i++) dst->histogram[i] += src->histogram[i];
+    if (!src->cell_hits || !ray_stats_fit(dst, src->grid_length, src->grid_height)) return;
+    for (int i = 0; i < src->grid_length * src->grid_height; i++) dst->cell_hits[i] += src->cell_hits[i];
+}
+
+Uint32 ray_stats_max_hits(ray_stats* s) {
+    Uint32 most = 0;
+    for (int i = 0; s->cell_hits && i < s->grid_length * s->grid_height; i++) most = SDL_max(most, s->cell_hits[i]);
+    return most;
+}
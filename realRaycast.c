@@ -1,44 +1,64 @@
 #include <SDL2/SDL.h>
 #include <math.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
 #include "./constants.h"
 #include "./grid.h"
-
-
-
-void setup(void);
-void process_input(void);
-void update(void);
-void render(void);
+#include "./input.h"
+#include "./fixed.h"
+#include "./dirty.h"
+#include "./raystats.h"
+#include "./world.h"
+#include "./heights.h"
+#include "./pipeline.h"
+#include "./pacer.h"
+#include "./mapcache.h"
+#include "./multiview.h"
+#include "./lighting.h"
+#include "./lod.h"
+#include "./pathfind.h"
+#include "./font.h"
+#include "./console.h"
+#include "./replay.h"
+#include "./verify.h"
+#include "./capture.h"
+
+
+
+typedef struct render_ctx render_ctx;
+
+void setup(world* w, camera* cam, int map_size);
+void generate_map(world* w, int length, int height);
+void wait_for_frame(void);
+void process_input(frame_pipeline* pipe, camera* cam);
+void update(world* w, camera* cam, int delta_ticks);
+void render(world* w, camera* cam, render_ctx* rc);
 void free_memory(void);
 
 float perc(int percent);
-void draw_rect(int x, int y, int length, int width, unsigned char r, unsigned char g, unsigned char b);
-void draw_rect_rgb(int x, int y, int length, int width, rgb color);
-void draw_point(int x, int y, int radius, unsigned char r, unsigned char g, unsigned char b);
-void draw_point_rgb(int x, int y, int radius, rgb color);
+void draw_rect(render_ctx* rc, int x, int y, int length, int width, unsigned char r, unsigned char g, unsigned char b);
+void draw_rect_rgb(render_ctx* rc, int x, int y, int length, int width, rgb color);
+void draw_point(render_ctx* rc, int x, int y, int radius, unsigned char r, unsigned char g, unsigned char b);
+void draw_point_rgb(render_ctx* rc, int x, int y, int radius, rgb color);
 void print_debug(void);
-void calc_grid_cam_center(void);
-void calc_grid_cam_zoom_p(void);
-void reset_grid_cam(void);
-void reset_player(void);
-void zoom_grid_cam(int zoom);
-void zoom_grid_cam_center(int zoom);
-void g_draw_rect(int x, int y, int length, int width, unsigned char r, unsigned char g, unsigned char b);
-void g_draw_rect_rgb(int x, int y, int length, int width, rgb color);
-void g_draw_point(int x, int y, int radius, unsigned char r, unsigned char g, unsigned char b);
-void g_draw_point_rgb(int x, int y, int radius, rgb color);
-int menu_selection(char* title, char options[11][26]);
-void debug_menu(void);
-void draw_rect_bordered(int x, int y, int length, int width, unsigned char fill_r, unsigned char fill_g, unsigned char fill_b,
+void calc_grid_cam_center(camera* cam);
+void calc_grid_cam_zoom_p(camera* cam);
+void reset_grid_cam(camera* cam);
+void zoom_grid_cam(camera* cam, int zoom);
+void zoom_grid_cam_center(camera* cam, int zoom);
+void camera_follow(camera* cam, player* p);
+void g_draw_rect(render_ctx* rc, camera* cam, int x, int y, int length, int width, unsigned char r, unsigned char g, unsigned char b);
+void g_draw_rect_rgb(render_ctx* rc, camera* cam, int x, int y, int length, int width, rgb color);
+void g_draw_point(render_ctx* rc, camera* cam, int x, int y, int radius, unsigned char r, unsigned char g, unsigned char b);
+void g_draw_point_rgb(render_ctx* rc, camera* cam, int x, int y, int radius, rgb color);
+void run_console_command(console_command* cmd);
+void draw_text(render_ctx* rc, int x, int y, int scale, const char* text, rgb color);
+void draw_console(render_ctx* rc, console* con);
+void draw_rect_bordered(render_ctx* rc, int x, int y, int length, int width, unsigned char fill_r, unsigned char fill_g, unsigned char fill_b,
     unsigned char border_r, unsigned char border_g, unsigned char border_b);
-void draw_rect_bordered_rgb(int x, int y, int length, int width, rgb fill, rgb border);
-void rotate_player(float angle);
-void push_player_forward(int force);
-void push_player_right(int force);
-void add_fill_dgp(int x, int y, rgb color);
+void draw_rect_bordered_rgb(render_ctx* rc, int x, int y, int length, int width, rgb fill, rgb border);
 int rad_deg(float radians);
-void add_temp_dgp(int x, int y, rgb color);
 int max(int val1, int val2);
 int min(int val1, int val2);
 int bounds(int minVal, int val, int maxVal);
@@ -50,9 +70,10 @@ int game_is_running = FALSE;
 SDL_Window* window = NULL;
 SDL_Renderer* renderer = NULL;
 
-int last_frame_time = 0;
+frame_pacer game_pacer; /* Paces the render loop, see pacer.h */
+int last_frame_ticks = 0;
 
-int initialize_window(void) {
+int initialize_window(int vsync) {
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
         fprintf(stderr, "Error initializing SDL.\n");
         return FALSE;
@@ -70,7 +91,7 @@ int initialize_window(void) {
         return FALSE;
     }
 
-    renderer = SDL_CreateRenderer(window, -1, 0); //Window, display driver, flags
+    renderer = SDL_CreateRenderer(window, -1, vsync ? SDL_RENDERER_PRESENTVSYNC : 0); //Window, display driver, flags
     if (!renderer) {
         fprintf(stderr, "Error creating SDL Renderer.\n");
         return FALSE;
@@ -79,6 +100,28 @@ int initialize_window(void) {
     return TRUE;
 }
 
+/* The window's display refresh rate, FPS when SDL can't tell */
+double display_refresh_hz(void) {
+    SDL_DisplayMode mode;
+    if (window && SDL_GetWindowDisplayMode(window, &mode) == 0 && mode.refresh_rate > 0) return mode.refresh_rate;
+    return FPS;
+}
+
+/* Switches the render loop's pacing, turning the renderer's vsync on or off to match */
+int set_pacing(int mode, double target_hz) {
+    int vsync = mode == PACE_VSYNC;
+    if (renderer && vsync != (game_pacer.mode == PACE_VSYNC)) {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        if (SDL_RenderSetVSync(renderer, vsync) != 0) return FALSE;
+#else
+        return FALSE; /* Vsync is fixed when the renderer is made, use --pace at start */
+#endif
+    }
+    game_pacer.refresh_hz = display_refresh_hz();
+    pacer_set_mode(&game_pacer, mode, target_hz);
+    return TRUE;
+}
+
 void destroy_window() {
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
@@ -87,66 +130,86 @@ void destroy_window() {
 
 /* Map Variables */
 
-/* Physical Grid */
-int grid_length;
-int grid_height;
-bool_cont* grid_enc;
 /* Grid Visual */
 rgb grid_bg = {255, 0, 255};
 rgb grid_fill_nonsolid = {160, 195, 115};
 rgb grid_fill_solid = {100, 110, 100};
 int grid_line_width = 1;
 rgb grid_line_fill = C_BLACK;
-int show_grid_lines = FALSE;
-/* Grid Visual Camera */
-int grid_cam_x;
-int grid_cam_y;
-int grid_cam_zoom;
-float grid_cam_zoom_p;
-int grid_cam_zoom_min;
-int grid_cam_zoom_max;
-int grid_cam_center_x;
-int grid_cam_center_y;
-/* Player */
-float player_x;
-int i_player_x;
-float player_y;
-int i_player_y;
-int player_radius = 10;
-float player_x_velocity;
-float player_y_velocity;
-float player_velocity_angle;
-int player_max_velocity = 300;
-float player_angle;
-const float FOV = M_PI / 3;
-int player_movement_accel = 20;
-int player_movement_decel = 20;
-float player_angle_increment = M_PI / 18;
-int player_rotation_speed = 10;
-
-void assign_i_player_pos(void) {
-    i_player_x = round(player_x);
-    i_player_y = round(player_y);
-}
 /* Player Grid Visual */
 int grid_player_pointer_dist = 15;
 int grid_player_pointer_radius_offset = 50;
 rgb grid_player_fill = {255, 50, 50};
-int grid_follow_player = TRUE;
-int show_player_vision = FALSE;
-int show_player_trail = FALSE;
-
-int render_in_first_person = FALSE;
 
 /* First Person Rendering */
 rgb fp_bg_top = {255, 0, 255};
 rgb fp_bg_bottom = {160, 195, 115};
 rgb wall_color = {150, 150, 150};
-int fp_brightness = 100;
-float fp_scale = 0.02f;
+/* Wall layer materials, 0 is wall_color */
+rgb wall_materials[WALL_MATERIALS] = {
+    {150, 150, 150}, {160, 90, 60}, {90, 120, 160}, {110, 150, 80}, {190, 170, 110}, {120, 80, 140}, {70, 70, 70}, {200, 200, 200},
+    {150, 60, 60}, {60, 140, 140}, {170, 120, 50}, {90, 90, 130}, {140, 140, 100}, {100, 60, 40}, {180, 110, 150}, {60, 100, 60}
+};
 unsigned int fp_render_distance = 1000;
 unsigned int fp_render_distance_scr = (WINDOW_HEIGHT / 2) + 150;
-int fp_show_walls = TRUE;
+
+/* Renderer */
+#define SHOWN_PATH_LEN 64
+
+struct render_ctx {
+    SDL_Renderer* renderer;
+    int render_in_first_person;
+    int show_player_vision;
+    int show_grid_lines;
+    int show_grid_crosshairs;
+    int fp_show_walls;
+    int fp_brightness;
+    float fp_scale;
+    int fp_lighting;
+    int show_grid_lighting;
+    int show_ray_heatmap; /* Needs RAY_STATS */
+    ray_stats ray_counts; /* Rays cast for this view since the last reset */
+    lightmap lighting;
+    lod_map map_lod;
+    map_view_cache map_view; /* Fallback when tile textures can't be made */
+    column_cache columns;
+    int split_views; /* First person views sharing the window, the player's and spectators' */
+    int view_threads;
+    view_batch views;
+    /* Overlays, handed in by the game and left NULL or empty by offscreen renders */
+    console* con; /* Drawn while open */
+    frame_capture* capture; /* Takes each finished frame while capturing */
+    xy shown_path[SHOWN_PATH_LEN]; /* Last path command's jump points, drawn on the map view */
+    int shown_path_len;
+    int shift_held; /* Marks the corner while left shift is down */
+};
+
+void render_ctx_init(render_ctx* rc, SDL_Renderer* sdl_renderer) {
+    memset(rc, 0, sizeof(*rc));
+    rc->renderer = sdl_renderer;
+    rc->fp_show_walls = TRUE;
+    rc->fp_brightness = 100;
+    rc->fp_scale = 0.02f;
+    rc->fp_lighting = TRUE;
+    rc->split_views = 1;
+    rc->view_threads = SDL_GetCPUCount();
+    lightmap_init(&rc->lighting);
+}
+
+void render_ctx_free(render_ctx* rc) {
+    map_view_free(&rc->map_view);
+    lightmap_free(&rc->lighting);
+    lod_free(&rc->map_lod);
+    ray_stats_free(&rc->ray_counts);
+    view_batch_free(&rc->views);
+}
+
+/* The game's own instances, everything the window, input and debug menu act on */
+world game_world; /* Simulated, see pipeline.h */
+world view_world; /* The render side's copy of the last snapshot */
+frame_pipeline game_pipe;
+camera game_camera;
+render_ctx game_render;
 
 /* Debug Vaiable Labels */
 struct int_varlabel {
@@ -159,55 +222,39 @@ struct flt_varlabel {
     float* value;
 };
 
-char int_vls_menu[11][26];
-char flt_vls_menu[11][26];
-
-#define INT_VLS_LEN 9
+#define INT_VLS_LEN 18
 struct int_varlabel int_vls[INT_VLS_LEN];
 
-#define FLT_VLS_LEN 3
+#define FLT_VLS_LEN 4
 struct flt_varlabel flt_vls[FLT_VLS_LEN];
 
-/* Debug Menu */
-char TOP_MENU[11][26] = {
-    "Set int variables",
-    "Set float variables",
-    "See all variables",
-    "Advance one frame",
-    "Switch viewpoints",
-    "Reset player",
-    "Close program",
-    "end"
-};
+/* Debug Console */
+console game_console;
+int console_text_scale = 2;
 
-int open_debug_menu = FALSE;
-int debug_menu_was_open = FALSE;
-int reopen_debug_menu = FALSE;
-int show_grid_crosshairs = FALSE;
+/* Frame timing for the console's profile command */
+typedef struct frame_profile {
+    Uint64 render_time;
+    int frames;
+    float input_delay; /* Summed milliseconds, see input_queue_delay */
+} frame_profile;
 
-struct debug_grid_point {
-    int x;
-    int y;
-    rgb color;
-    struct debug_grid_point* next;
-};
+frame_profile game_profile;
+
+/* Pathfinding over the simulated world, for the console's path commands */
+pathfinder game_paths;
+
+/* Input recording and replay, see replay.h */
+replay_file game_record; /* Open while recording */
+replay_file game_replay; /* Open while replaying */
+
+/* Frame capture to PPMs or a stream file, see capture.h */
+frame_capture game_capture;
 
 int dgp_radius = 5;
-int num_fill_dgps = 0;
-int max_fill_dgps = FPS / 2;
-struct debug_grid_point* fill_dgp_head;
-struct debug_grid_point* fill_dgp_tail;
-struct debug_grid_point* temp_dgp_head;
-struct debug_grid_point* temp_dgp_tail;
 
 /* User Input Variables */
-int shift = FALSE;
-int left_mouse_down = FALSE;
-int prev_mouse_x = -1;
-int prev_mouse_y = -1;
-char horizontal_input;
-char vertical_input;
-char rotation_input = 0;
+input_frame input;
 
 
 /* Color */
@@ -223,50 +270,50 @@ rgb brighten(rgb color, int offset) {
 }
 
 /* Graphics */
-void draw_rect_a(int x, int y, int length, int width, unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+void draw_rect_a(render_ctx* rc, int x, int y, int length, int width, unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
     SDL_Rect rect = {x, y, length, width};
-    SDL_SetRenderDrawColor(renderer, r, g, b, a);
-    SDL_RenderFillRect(renderer, &rect);
+    SDL_SetRenderDrawColor(rc->renderer, r, g, b, a);
+    SDL_RenderFillRect(rc->renderer, &rect);
 }
 
-void draw_rect_a_rgb(int x, int y, int length, int width, rgb color, int a) {
-    draw_rect_a(x, y, length, width, color.r, color.g, color.b, a);
+void draw_rect_a_rgb(render_ctx* rc, int x, int y, int length, int width, rgb color, int a) {
+    draw_rect_a(rc, x, y, length, width, color.r, color.g, color.b, a);
 }
 
-void draw_rect(int x, int y, int length, int width, unsigned char r, unsigned char g, unsigned char b) {
-    draw_rect_a(x, y, length, width, r, g, b, 255);
+void draw_rect(render_ctx* rc, int x, int y, int length, int width, unsigned char r, unsigned char g, unsigned char b) {
+    draw_rect_a(rc, x, y, length, width, r, g, b, 255);
 }
 
-void set_draw_color_rgb(rgb color) {
-    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 255);
+void set_draw_color_rgb(render_ctx* rc, rgb color) {
+    SDL_SetRenderDrawColor(rc->renderer, color.r, color.g, color.b, 255);
 }
 
-void draw_rect_rgb(int x, int y, int length, int width, rgb color) {
-    draw_rect(x, y, length, width, color.r, color.g, color.b);
+void draw_rect_rgb(render_ctx* rc, int x, int y, int length, int width, rgb color) {
+    draw_rect(rc, x, y, length, width, color.r, color.g, color.b);
 }
 
-void draw_rect_bordered(int x, int y, int length, int width, unsigned char fill_r, unsigned char fill_g, unsigned char fill_b,
+void draw_rect_bordered(render_ctx* rc, int x, int y, int length, int width, unsigned char fill_r, unsigned char fill_g, unsigned char fill_b,
     unsigned char border_r, unsigned char border_g, unsigned char border_b) {
     SDL_Rect rect = {x, y, length, width};
-    SDL_SetRenderDrawColor(renderer, fill_r, fill_g, fill_b, 255);
-    SDL_RenderFillRect(renderer, &rect);
-    SDL_SetRenderDrawColor(renderer, border_r, border_g, border_b, 255);
-    SDL_RenderDrawRect(renderer, &rect);
+    SDL_SetRenderDrawColor(rc->renderer, fill_r, fill_g, fill_b, 255);
+    SDL_RenderFillRect(rc->renderer, &rect);
+    SDL_SetRenderDrawColor(rc->renderer, border_r, border_g, border_b, 255);
+    SDL_RenderDrawRect(rc->renderer, &rect);
 }
 
-void draw_rect_bordered_rgb(int x, int y, int length, int width, rgb fill, rgb border) {
-    draw_rect_bordered(x, y, length, width, fill.r, fill.g, fill.b, border.r, border.g, border.b);
+void draw_rect_bordered_rgb(render_ctx* rc, int x, int y, int length, int width, rgb fill, rgb border) {
+    draw_rect_bordered(rc, x, y, length, width, fill.r, fill.g, fill.b, border.r, border.g, border.b);
 }
 
-void draw_point(int x, int y, int radius, unsigned char r, unsigned char g, unsigned char b) {
-    draw_rect_bordered(x - radius, y - radius, radius * 2, radius * 2, r, g, b, 0, 0, 0);
+void draw_point(render_ctx* rc, int x, int y, int radius, unsigned char r, unsigned char g, unsigned char b) {
+    draw_rect_bordered(rc, x - radius, y - radius, radius * 2, radius * 2, r, g, b, 0, 0, 0);
 }
 
-void draw_point_rgb(int x, int y, int radius, rgb color) {
-    draw_point(x, y, radius, color.r, color.g, color.b);
+void draw_point_rgb(render_ctx* rc, int x, int y, int radius, rgb color) {
+    draw_point(rc, x, y, radius, color.r, color.g, color.b);
 }
 
-void vertical_gradient(int x, int y, int length, int width, rgb top_color, rgb bottom_color) {
+void vertical_gradient(render_ctx* rc, int x, int y, int length, int width, rgb top_color, rgb bottom_color) {
     float c_r = (float) (top_color.r - bottom_color.r) / -width;
     float c_g = (float) (top_color.g - bottom_color.g) / -width;
     float c_b = (float) (top_color.b - bottom_color.b) / -width;
@@ -276,140 +323,55 @@ void vertical_gradient(int x, int y, int length, int width, rgb top_color, rgb b
     float grad_b = top_color.b;
 
     for (int i = 0; i < width; i++) {
-        draw_rect(x, y + i, length, 1, round(grad_r), round(grad_g), round(grad_b));
+        draw_rect(rc, x, y + i, length, 1, round(grad_r), round(grad_g), round(grad_b));
         grad_r += c_r;
         grad_g += c_g;
         grad_b += c_b;
     }
 }
 
+void draw_text(render_ctx* rc, int x, int y, int scale, const char* text, rgb color) {
+    set_draw_color_rgb(rc, color);
+    for (; *text; text++, x += (FONT_WIDTH + 1) * scale) {
+        unsigned char* glyph = font_glyph(*text);
+        for (int row = 0; row < FONT_HEIGHT; row++) {
+            for (int col = 0; col < FONT_WIDTH; col++) {
+                if (!(glyph[row] & (0x10 >> col))) continue;
+                SDL_Rect px = {x + (col * scale), y + (row * scale), scale, scale};
+                SDL_RenderFillRect(rc->renderer, &px);
+            }
+        }
+    }
+}
+
 /* Grid Graphics */
-void g_draw_rect(int x, int y, int length, int width, unsigned char r, unsigned char g, unsigned char b) {
-    int real_length = ceil(length * grid_cam_zoom_p);
-    int real_width = ceil(width * grid_cam_zoom_p);
-    draw_rect(
-        round( (x - grid_cam_x) * grid_cam_zoom_p ),
-        round( (y - grid_cam_y) * grid_cam_zoom_p ),
+void g_draw_rect(render_ctx* rc, camera* cam, int x, int y, int length, int width, unsigned char r, unsigned char g, unsigned char b) {
+    int real_length = ceil(length * cam->zoom_p);
+    int real_width = ceil(width * cam->zoom_p);
+    draw_rect(rc,
+        round( (x - cam->x) * cam->zoom_p ),
+        round( (y - cam->y) * cam->zoom_p ),
         real_length,
         real_width,
         r, g, b
     );
 }
 
-void g_draw_rect_rgb(int x, int y, int length, int width, rgb color) {
-    g_draw_rect(x, y, length, width, color.r, color.g, color.b);
+void g_draw_rect_rgb(render_ctx* rc, camera* cam, int x, int y, int length, int width, rgb color) {
+    g_draw_rect(rc, cam, x, y, length, width, color.r, color.g, color.b);
 }
 
-void g_draw_point(int x, int y, int radius, unsigned char r, unsigned char g, unsigned char b) {
-    draw_point(
-        round((x - grid_cam_x) * grid_cam_zoom_p),
-        round((y - grid_cam_y) * grid_cam_zoom_p),
-        round(radius * grid_cam_zoom_p),
+void g_draw_point(render_ctx* rc, camera* cam, int x, int y, int radius, unsigned char r, unsigned char g, unsigned char b) {
+    draw_point(rc,
+        round((x - cam->x) * cam->zoom_p),
+        round((y - cam->y) * cam->zoom_p),
+        round(radius * cam->zoom_p),
         r, g, b
     );
 }
 
-void g_draw_point_rgb(int x, int y, int radius, rgb color) {
-    g_draw_point(x, y, radius, color.r, color.g, color.b);
-}
-
-/* Grid */
-int get_grid_bool(int x, int y) {
-    return bit_bool(
-        grid_enc[((grid_length * y) + x) / (SIZE_BOOL_CONT * 8)],
-        ((grid_length * y) + x) % (SIZE_BOOL_CONT * 8)
-    );
-}
-
-int get_grid_bool_coords(int x, int y) {
-    return get_grid_bool(x / GRID_SPACING, y / GRID_SPACING);
-}
-
-/* Raycasting */
-typedef struct xy {
-    int x;
-    int y;
-} xy;
-
-xy raycast(int x, int y, float angle) {
-    int c_hx, c_hy;
-    int d_hx, d_hy;
-    int c_vx, c_vy;
-    int d_vx, d_vy;
-    float alpha;
-    if (angle < M_PI / 2) {
-        alpha = angle;
-        c_hy = ((ceil((float) y / GRID_SPACING)) * GRID_SPACING);// - 1;
-        c_hx = ((c_hy - y) / tan(alpha)) + x;
-        d_hx = GRID_SPACING / tan(alpha);
-        d_hy = GRID_SPACING;
-        c_vx = (floor(x / GRID_SPACING) * GRID_SPACING) + GRID_SPACING;
-        c_vy = (tan(alpha) * (c_vx - x)) + y;
-        d_vx = GRID_SPACING;
-        d_vy = tan(alpha) * (d_vx);
-    } else if (angle < M_PI) {
-        alpha = angle - (M_PI / 2);
-        c_hy = (ceil((float) y / GRID_SPACING) * GRID_SPACING);// - 1;
-        c_hx = tan(alpha) * (y - c_hy) + x;
-        d_hy = GRID_SPACING;
-        d_hx = -GRID_SPACING * tan(alpha);
-        c_vx = (floor(x / GRID_SPACING) * GRID_SPACING);// - 1;
-        c_vy = y + ((x - c_vx)/ tan(alpha));
-        d_vx = -GRID_SPACING;
-        d_vy = GRID_SPACING / tan(alpha);
-    } else if (angle < M_PI + (M_PI / 2)) {
-        alpha = angle - M_PI;
-        c_hy = (floor((float) y / GRID_SPACING) * GRID_SPACING);
-        c_hx = x + (c_hy - y) / tan(alpha);
-        d_hy = -GRID_SPACING;
-        d_hx = -GRID_SPACING * tan((M_PI / 2) - alpha);
-        c_vx = (floor(x / GRID_SPACING) * GRID_SPACING);// - 1;
-        c_vy = y - (tan(alpha) * (x - c_vx));
-        d_vx = -GRID_SPACING;
-        d_vy = -GRID_SPACING * tan(alpha);
-    } else {
-        alpha = angle - (M_PI + (M_PI / 2));
-        c_hy = ((floor((float) y / GRID_SPACING) - 1) * GRID_SPACING) + GRID_SPACING;
-        c_hx = x - tan(alpha) * (c_hy - y);
-        d_hy = -GRID_SPACING;
-        d_hx = GRID_SPACING * tan(alpha);
-        c_vx = (floor((float) x / GRID_SPACING) * GRID_SPACING) + GRID_SPACING;
-        c_vy = y - (c_vx - x) / tan(alpha);
-        d_vx = GRID_SPACING;
-        d_vy = -GRID_SPACING / tan(alpha);
-    }
-    
-    while (!(
-        (
-            get_grid_bool(c_hx / GRID_SPACING, (c_hy / GRID_SPACING) - 1) ||
-            get_grid_bool(c_hx / GRID_SPACING, c_hy / GRID_SPACING)
-        ) || !(
-            ( 0 < (c_hx / GRID_SPACING) && (c_hx / GRID_SPACING) < grid_length ) &&
-            ( 0 < (c_hy / GRID_SPACING) && (c_hy / GRID_SPACING) < grid_height )
-        ))
-    ) {
-        if (show_player_vision) add_temp_dgp(c_hx, c_hy, C_RED);
-        c_hx += d_hx; c_hy += d_hy;
-    }
-
-    while (!(
-        (
-            get_grid_bool((c_vx / GRID_SPACING) - 1, c_vy / GRID_SPACING) ||
-            get_grid_bool(c_vx / GRID_SPACING, c_vy / GRID_SPACING)
-        ) || !(
-            ( 0 < (c_vx / GRID_SPACING) && (c_vx / GRID_SPACING) < grid_length ) &&
-            ( 0 < (c_vy / GRID_SPACING) && (c_vy / GRID_SPACING) < grid_height )
-        )
-    )) {
-        if (show_player_vision) add_temp_dgp(c_vx, c_vy, C_RED);
-        c_vx += d_vx; c_vy += d_vy;
-    }
-
-    if ( sqrt(pow(c_hx - x, 2) + pow(c_hy - y, 2)) < sqrt(pow(c_vx - x, 2) + pow(c_vy - y, 2)) ) {
-        return (xy) {c_hx, c_hy};
-    } else {
-        return (xy) {c_vx, c_vy};
-    }
+void g_draw_point_rgb(render_ctx* rc, camera* cam, int x, int y, int radius, rgb color) {
+    g_draw_point(rc, cam, x, y, radius, color.r, color.g, color.b);
 }
 
 /* Utilities */
@@ -434,190 +396,447 @@ int bounds(int minVal, int val, int maxVal) {
 }
 
 /* Grid Variable Calculations */
-void calc_grid_cam_zoom_p(void) {
-    grid_cam_zoom_p = perc(grid_cam_zoom);
+void calc_grid_cam_zoom_p(camera* cam) {
+    cam->zoom_p = perc(cam->zoom);
 }
 
-void calc_grid_cam_center(void) {
-    grid_cam_center_x = grid_cam_x + round( (WINDOW_WIDTH / 2) * (1.0f / grid_cam_zoom_p) );
-    grid_cam_center_y = grid_cam_y + round( (WINDOW_HEIGHT / 2) * (1.0f / grid_cam_zoom_p) );
+void calc_grid_cam_center(camera* cam) {
+    cam->center_x = cam->x + round( (WINDOW_WIDTH / 2) * (1.0f / cam->zoom_p) );
+    cam->center_y = cam->y + round( (WINDOW_HEIGHT / 2) * (1.0f / cam->zoom_p) );
 }
 
 /* Grid Resets */
-void reset_grid_cam(void) {
-    grid_cam_x = 0;
-    grid_cam_y = 0;
-    grid_cam_zoom = 100;
-    calc_grid_cam_zoom_p();
-    grid_cam_zoom_min = 40;
-    grid_cam_zoom_max = 200;
-}
-
-void reset_player(void) {
-    player_x = GRID_SPACING * 4;
-    player_y = GRID_SPACING * 4;
-    assign_i_player_pos();
-    player_x_velocity = 0;
-    player_y_velocity = 0;
-    player_angle = 0;
+void reset_grid_cam(camera* cam) {
+    cam->x = 0;
+    cam->y = 0;
+    cam->zoom = 100;
+    calc_grid_cam_zoom_p(cam);
+    cam->zoom_min = 1; /* Low enough to fit large maps, the LOD tiles keep it cheap */
+    cam->zoom_max = 200;
 }
 
 /* Grid Zoom */
-void zoom_grid_cam(int zoom) {
-    grid_cam_zoom += zoom;
-    if (grid_cam_zoom < grid_cam_zoom_min) grid_cam_zoom = grid_cam_zoom_min;
-    else if (grid_cam_zoom > grid_cam_zoom_max) grid_cam_zoom = grid_cam_zoom_max;
-    calc_grid_cam_zoom_p();
+void zoom_grid_cam(camera* cam, int zoom) {
+    cam->zoom += zoom;
+    if (cam->zoom < cam->zoom_min) cam->zoom = cam->zoom_min;
+    else if (cam->zoom > cam->zoom_max) cam->zoom = cam->zoom_max;
+    calc_grid_cam_zoom_p(cam);
 }
 
-void zoom_grid_cam_center(int zoom) {
-    calc_grid_cam_center();
-    int old_grid_cam_center_x = grid_cam_center_x;
-    int old_grid_cam_center_y = grid_cam_center_y;
-    zoom_grid_cam(zoom);
-    grid_cam_x = old_grid_cam_center_x - round( (WINDOW_WIDTH / 2) * (1.0f / grid_cam_zoom_p) );
-    grid_cam_y = old_grid_cam_center_y - round( (WINDOW_HEIGHT / 2) * (1.0f / grid_cam_zoom_p) );
-}
-
-/* Player Control */
-void rotate_player(float angle) {
-    player_angle += angle;
-    while (player_angle < 0) player_angle += M_PI * 2;
-    while (player_angle >= M_PI * 2) player_angle -= (M_PI * 2);
+/* Cells at least partly on screen, clipped to the map */
+cell_box visible_cells(camera* cam, world* w) {
+    return (cell_box) {
+        max(cam->x / GRID_SPACING, 0),
+        max(cam->y / GRID_SPACING, 0),
+        min((cam->x + (int) (WINDOW_WIDTH / cam->zoom_p)) / GRID_SPACING, w->grid_length - 1),
+        min((cam->y + (int) (WINDOW_HEIGHT / cam->zoom_p)) / GRID_SPACING, w->grid_height - 1)
+    };
 }
 
-void push_player_forward(int force) {
-    player_x_velocity += cos(player_angle) * force;
-    player_y_velocity += sin(player_angle) * force;
+void zoom_grid_cam_center(camera* cam, int zoom) {
+    calc_grid_cam_center(cam);
+    int old_grid_cam_center_x = cam->center_x;
+    int old_grid_cam_center_y = cam->center_y;
+    zoom_grid_cam(cam, zoom);
+    cam->x = old_grid_cam_center_x - round( (WINDOW_WIDTH / 2) * (1.0f / cam->zoom_p) );
+    cam->y = old_grid_cam_center_y - round( (WINDOW_HEIGHT / 2) * (1.0f / cam->zoom_p) );
 }
 
-void push_player_right(int force) {
-    player_angle += M_PI / 2;
-    push_player_forward(force);
-    player_angle -= M_PI / 2;
+void camera_follow(camera* cam, player* p) {
+    cam->x = round( p->x - ((WINDOW_WIDTH / 2) * (1.0f / cam->zoom_p)) );
+    cam->y = round( p->y - ((WINDOW_HEIGHT / 2) * (1.0f / cam->zoom_p)) );
 }
 
 /* Debugging */
 void print_debug(void) {
-    
+    printf("input: %d events last frame, oldest queued %.2f ms\n", input.num_events, input_queue_delay(&input));
 }
 
 void print_rgb(rgb color) {
     printf("(%d, %d, %d)", color.r, color.g, color.b);
 }
 
-int menu_selection(char* title, char options[11][26]) {
-    while (TRUE) {
-        int op_i;
-        printf("\n%s\n", title);
-        for (op_i = 0; strcmp(options[op_i], "end") != 0; op_i++) {
-            printf("%s %d. %s\n", (
-                op_i == 9 ? "" : " " /* Spacing for the tenth option so the numbers line up */
-            ), op_i + 1, options[op_i]);
-        };
+/* Console variable names are their labels with underscores for spaces */
+int varlabel_matches(const char* label, const char* name) {
+    for (; *label && *name; label++, name++) {
+        if (*label != *name && !(*label == ' ' && *name == '_')) return FALSE;
+    }
+    return !*label && !*name;
+}
+
+int* find_int_var(const char* name) {
+    for (int i = 0; i < INT_VLS_LEN; i++) if (varlabel_matches(int_vls[i].label, name)) return int_vls[i].value;
+    return NULL;
+}
+
+float* find_flt_var(const char* name) {
+    for (int i = 0; i < FLT_VLS_LEN; i++) if (varlabel_matches(flt_vls[i].label, name)) return flt_vls[i].value;
+    return NULL;
+}
+
+void print_var(console* con, int client, const char* label, int* int_val, float* flt_val) {
+    char name[CONSOLE_LINE_LEN];
+    int i;
+    for (i = 0; label[i] && i < CONSOLE_LINE_LEN - 1; i++) name[i] = label[i] == ' ' ? '_' : label[i];
+    name[i] = '\0';
+    if (int_val) console_print(con, client, "%s = %d", name, *int_val);
+    else console_print(con, client, "%s = %f", name, *flt_val);
+}
+
+void print_pacing(console* con, int client) {
+    frame_pacer* p = &game_pacer;
+    double mean, deviation, worst;
+    pacer_stats(p, &mean, &deviation, &worst);
+    console_print(con, client, "pace %s at %.1f Hz: %d of %d frames missed", pace_mode_names[p->mode], pacer_rate(p), p->missed, p->frames);
+    console_print(con, client, "frame time %.2f ms avg, %.2f ms deviation, %.2f ms worst", mean, deviation, worst);
+    pacer_reset_stats(p);
+}
+
+/* Totals and the lines tested per ray histogram, one row of buckets per line */
+void print_ray_stats(console* con, int client, ray_stats* rs) {
+    console_print(con, client, "%lld rays in %d frames, %lld lines tested, %lld lookups, %lld overshoot", rs->rays, rs->frames, rs->tests, rs->lookups, rs->overshoot);
+    for (int row = 0; row < RAY_STATS_BUCKETS; row += 8) {
+        char line[CONSOLE_LINE_LEN];
+        int len = snprintf(line, sizeof(line), "%3d+:", row * RAY_STATS_BUCKET_WIDTH);
+        for (int i = row; i < row + 8; i++) {
+            len += snprintf(line + len, sizeof(line) - len, " %.1f%%", rs->rays ? (100.0 * rs->histogram[i]) / rs->rays : 0);
+        }
+        console_print(con, client, "%s", line);
+    }
+}
+
+void print_profile(console* con, int client) {
+    frame_pipeline* pipe = &game_pipe;
+    double freq = SDL_GetPerformanceFrequency() / 1000.0;
+    console_print(con, client, "sim: %d ticks, %.3f ms avg", pipe->sim_ticks,
+        pipe->sim_ticks ? (pipe->sim_time / freq) / pipe->sim_ticks : 0);
+    console_print(con, client, "render: %d frames, %.3f ms avg", game_profile.frames,
+        game_profile.frames ? (game_profile.render_time / freq) / game_profile.frames : 0);
+    console_print(con, client, "input: %.1f ms avg queue delay",
+        game_profile.frames ? game_profile.input_delay / game_profile.frames : 0);
+    print_pacing(con, client);
+#if RAY_STATS
+    ray_stats* rs = &game_render.ray_counts;
+    console_print(con, client, "rays: %.1f lines tested per ray, %.0f lookups per frame, %.1f%% overshoot",
+        rs->rays ? (double) rs->tests / rs->rays : 0, rs->frames ? (double) rs->lookups / rs->frames : 0,
+        rs->tests ? (100.0 * rs->overshoot) / rs->tests : 0);
+#endif
+    pipe->sim_time = 0;
+    pipe->sim_ticks = 0;
+    memset(&game_profile, 0, sizeof(game_profile));
+}
+
+/* Capture counters so far, for the console and the exit report */
+void print_capture(console* con, int client) {
+    frame_capture* cap = &game_capture;
+    double freq = SDL_GetPerformanceFrequency() / 1000.0;
+    if (cap->lock) SDL_LockMutex(cap->lock);
+    int written = cap->written;
+    int failed = cap->failed;
+    long long bytes = cap->bytes;
+    Uint64 encode_time = cap->encode_time;
+    if (cap->lock) SDL_UnlockMutex(cap->lock);
+
+    console_print(con, client, "capture %s: %d frames, %d written, %d dropped, %d failed", cap->path, cap->frames, written, cap->dropped, failed);
+    console_print(con, client, "%.2f MB, read %.3f ms avg, encode %.3f ms avg", bytes / (1024.0 * 1024.0),
+        cap->frames - cap->dropped ? (cap->read_time / freq) / (cap->frames - cap->dropped) : 0,
+        written ? (encode_time / freq) / written : 0);
+}
+
+/* Runs at a frame boundary with sim_lock held, so the simulation sees all of a frame's commands at once */
+void run_console_command(console_command* cmd) {
+    console* con = &game_console;
+    int client = cmd->client;
+    char verb[16] = "";
+    char name[CONSOLE_LINE_LEN] = "";
+    char value[32] = "";
+    int args = sscanf(cmd->line, "%15s %95s %31s", verb, name, value);
+    int* int_var = find_int_var(name);
+    float* flt_var = find_flt_var(name);
+
+    if (args < 1) return;
+    if (strcmp(verb, "help") == 0) {
+        console_print(con, client, "list, get VAR, set VAR VALUE, toggle VAR");
+        console_print(con, client, "cell X Y [0/1], fill X0 Y0 X1 Y1 0/1, wall X0 Y0 X1 Y1 HEIGHT [MATERIAL]");
+        console_print(con, client, "light add X Y INTENSITY RADIUS, light clear, light list, bake");
+        console_print(con, client, "path X0 Y0 X1 Y1, pathbench [QUERIES] [THREADS]");
+        console_print(con, client, "capture start DIR or FILE%s, capture stop, capture", CAPTURE_STREAM_SUFFIX);
+        console_print(con, client, "pace [uncapped/fixed/vsync/adaptive] [HZ], raystats [reset]");
+        console_print(con, client, "viewbench [VIEWS] [COLUMNS] [THREADS]");
+        console_print(con, client, "view, reset, pause, resume, step [N], profile, quit");
+
+    } else if (strcmp(verb, "list") == 0) {
+        for (int i = 0; i < INT_VLS_LEN; i++) print_var(con, client, int_vls[i].label, int_vls[i].value, NULL);
+        for (int i = 0; i < FLT_VLS_LEN; i++) print_var(con, client, flt_vls[i].label, NULL, flt_vls[i].value);
+
+    } else if (strcmp(verb, "get") == 0 || strcmp(verb, "set") == 0 || strcmp(verb, "toggle") == 0) {
+        if (!int_var && !flt_var) {
+            console_print(con, client, "unknown variable '%s'", name);
+            return;
+        }
+        if (strcmp(verb, "set") == 0) {
+            if (args < 3) {
+                console_print(con, client, "usage: set VAR VALUE");
+                return;
+            }
+            if (int_var) *int_var = atoi(value);
+            else *flt_var = atof(value);
+        } else if (strcmp(verb, "toggle") == 0) {
+            if (!int_var) {
+                console_print(con, client, "'%s' is not a toggle", name);
+                return;
+            }
+            *int_var = !*int_var;
+        }
+        print_var(con, client, name, int_var, flt_var);
+
+    } else if (strcmp(verb, "cell") == 0 || strcmp(verb, "fill") == 0) { /* Map edits, a cell without a value toggles */
+        int v[5];
+        int num = sscanf(cmd->line, "%*s %d %d %d %d %d", &v[0], &v[1], &v[2], &v[3], &v[4]);
+        int ok;
+        if (verb[0] == 'c') ok = num == 2 ? world_toggle_cell(&game_world, v[0], v[1]) : num == 3 && world_set_cell(&game_world, v[0], v[1], v[2]);
+        else ok = num == 5 && world_fill_cells(&game_world, v[0], v[1], v[2], v[3], v[4]) >= 0;
+        if (!ok) console_print(con, client, "usage: cell X Y [0/1], fill X0 Y0 X1 Y1 0/1, inside the map");
+
+    } else if (strcmp(verb, "wall") == 0) { /* Heights in eighths of a full wall, 0 opens the cells */
+        int v[6] = {0};
+        int num = sscanf(cmd->line, "%*s %d %d %d %d %d %d", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+        if (num < 5 || world_fill_walls(&game_world, v[0], v[1], v[2], v[3], v[4], v[5]) < 0) {
+            console_print(con, client, "usage: wall X0 Y0 X1 Y1 HEIGHT [MATERIAL], height 0 to %d eighths, material 0 to %d",
+                WALL_HEIGHT_MAX, WALL_MATERIALS - 1);
+        }
 
-        int choice = -1;
-        printf("(Enter '-1' to return): "); scanf("%d", &choice);
-        if (choice == -1) return -1;
-        if (1 <= choice && choice <= op_i) return choice - 1;
-        else continue;
-    }
-}
-
-void debug_menu(void) {
-    open_debug_menu = FALSE;
-    debug_menu_was_open = TRUE;
-    reopen_debug_menu = FALSE;
-    int loop = TRUE;
-    while (loop) {
-        switch (menu_selection("Debug Menu", TOP_MENU)) {
-            case 0: { /* Set int variables */
-                int var_choice = menu_selection("Select varible", int_vls_menu);
-                if (var_choice == -1) break;
-                struct int_varlabel* vl_choice = &int_vls[var_choice];
-                printf("(%s) = %d\n", vl_choice->label, *vl_choice->value);
-                printf("Set variable (%s) to ", vl_choice->label);
-                scanf("%d", vl_choice->value);
-                break;
+    } else if (strcmp(verb, "light") == 0) { /* Lights are render side, they relight at the next sync */
+        lightmap* lm = &game_render.lighting;
+        int v[4];
+        if (strcmp(name, "add") == 0) {
+            if (sscanf(cmd->line, "%*s %*s %d %d %d %d", &v[0], &v[1], &v[2], &v[3]) != 4 || !lightmap_add_light(lm, v[0], v[1], v[2], v[3])) {
+                console_print(con, client, "usage: light add X Y INTENSITY RADIUS, intensity 0 or more, up to %d lights", MAX_LIGHTS);
             }
-            case 1: { /* Set float variables */
-                int var_choice = menu_selection("Select variable", flt_vls_menu);
-                if (var_choice == -1) break;
-                struct flt_varlabel* vl_choice = &flt_vls[var_choice];
-                printf("(%s) = %f\n", vl_choice->label, *vl_choice->value);
-                printf("Set variable (%s) to ", vl_choice->label);
-                scanf("%f", vl_choice->value);
-                break;
+        } else if (strcmp(name, "clear") == 0) lightmap_clear_lights(lm);
+        else if (strcmp(name, "list") == 0) {
+            for (int i = 0; i < lm->num_lights; i++) {
+                point_light* l = &lm->lights[i];
+                console_print(con, client, "light %d at (%d, %d), intensity %d, radius %d", i, l->x, l->y, l->intensity, l->radius);
             }
-            case 2: /* See variables */
-                for (int i = 0; i < INT_VLS_LEN; i++) printf("(%s): %d\n", int_vls[i].label, *int_vls[i].value);
-                for (int i = 0; i < FLT_VLS_LEN; i++) printf("(%s): %f\n", flt_vls[i].label, *flt_vls[i].value);
-                print_debug();
-                break;
-            case 3: /* Advance one frame */
-                open_debug_menu = TRUE;
-                reopen_debug_menu = TRUE;
-                loop = FALSE;
-                break;
-            case 4: /* Switch viewpoints */
-                render_in_first_person = !render_in_first_person;
-                break;
-            case 5: /* Reset player */
-                reset_grid_cam();
-                reset_player();
-                break;
-            case 6: /* Close Program */
-                game_is_running = FALSE;
-                loop = FALSE;
-                break;
-            default:
-                loop = FALSE;
-        }
-    }
-}
-
-void new_dgp(int x, int y, rgb color, struct debug_grid_point** head, struct debug_grid_point** tail) {
-    struct debug_grid_point* p = malloc(sizeof(*p));
-    p->x = x;
-    p->y = y;
-    p->color = color;
-    p->next = NULL;
-    if (*head) {
-        (*tail)->next = p;
-        *tail = p;
-    } else {
-        *head = p;
-        *tail = p;
-    }
+        } else console_print(con, client, "usage: light add/clear/list");
+
+    } else if (strcmp(verb, "bake") == 0) {
+        game_render.lighting.rebake_all = TRUE;
+        lightmap_sync(&game_render.lighting, &view_world);
+        console_print(con, client, "baked %d cells in %.3f ms", game_render.lighting.last_bake_cells,
+            game_render.lighting.last_bake_time / (SDL_GetPerformanceFrequency() / 1000.0));
+
+    } else if (strcmp(verb, "path") == 0) {
+        int v[4];
+        if (sscanf(cmd->line, "%*s %d %d %d %d", &v[0], &v[1], &v[2], &v[3]) != 4) {
+            console_print(con, client, "usage: path X0 Y0 X1 Y1");
+            return;
+        }
+        path_query q = {v[0], v[1], v[2], v[3], game_render.shown_path, SHOWN_PATH_LEN};
+        pathfinder_sync(&game_paths, &game_world);
+        path_find(&game_paths, &game_paths.pools[0], &game_world, &q);
+        game_render.shown_path_len = SDL_max(SDL_min(q.num_points, SHOWN_PATH_LEN), 0);
+        if (q.num_points < 0) console_print(con, client, "no path");
+        else console_print(con, client, "%d jump points, %.1f cells long", q.num_points, q.cost / (float) PATH_STRAIGHT_COST);
+
+    } else if (strcmp(verb, "pathbench") == 0) { /* Random open cell pairs, searched in parallel */
+        int num_queries = args >= 2 ? max(atoi(name), 1) : 1000;
+        int num_threads = args >= 3 ? atoi(value) : SDL_GetCPUCount();
+        path_query* queries = malloc(num_queries * sizeof(*queries));
+        if (!queries) {
+            console_print(con, client, "out of memory for %d queries", num_queries);
+            return;
+        }
+        Uint32 seed = 12345;
+        xy from, to;
+        for (int i = 0; i < num_queries; i++) {
+            if (!random_open_cell(&game_world, &seed, &from) || !random_open_cell(&game_world, &seed, &to)) {
+                console_print(con, client, "no open cells to search between");
+                free(queries);
+                return;
+            }
+            queries[i] = (path_query) {from.x, from.y, to.x, to.y, NULL, 0};
+        }
+        Uint64 start = SDL_GetPerformanceCounter();
+        path_batch(&game_paths, &game_world, queries, num_queries, num_threads);
+        double ms = (SDL_GetPerformanceCounter() - start) / (SDL_GetPerformanceFrequency() / 1000.0);
+        int found = 0;
+        for (int i = 0; i < num_queries; i++) found += queries[i].num_points >= 0;
+        console_print(con, client, "%d paths (%d found) in %.3f ms, %.0f per second", num_queries, found, ms, num_queries / (ms / 1000));
+        free(queries);
+
+    } else if (strcmp(verb, "capture") == 0) {
+        char path[sizeof(game_capture.path)];
+        if (strcmp(name, "start") == 0) {
+            if (sscanf(cmd->line, "%*s %*s %255s", path) != 1) {
+                console_print(con, client, "usage: capture start DIR or FILE%s", CAPTURE_STREAM_SUFFIX);
+                return;
+            }
+            capture_stop(&game_capture);
+            if (!capture_start(&game_capture, path, WINDOW_WIDTH, WINDOW_HEIGHT)) console_print(con, client, "can't capture to %s", path);
+        } else if (strcmp(name, "stop") == 0) {
+            capture_stop(&game_capture);
+            print_capture(con, client);
+        } else if (game_capture.frames || game_capture.thread) print_capture(con, client);
+        else console_print(con, client, "not capturing");
+
+    } else if (strcmp(verb, "pace") == 0) { /* Without a mode, the frame times since the last report */
+        if (args >= 2) {
+            int mode = pace_mode_from_name(name);
+            if (mode < 0) {
+                console_print(con, client, "usage: pace [uncapped/fixed/vsync/adaptive] [HZ]");
+                return;
+            }
+            if (!set_pacing(mode, args >= 3 ? atof(value) : 0)) console_print(con, client, "can't switch vsync here, start with --pace");
+            pacer_reset_stats(&game_pacer);
+            console_print(con, client, "pace %s at %.1f Hz", pace_mode_names[game_pacer.mode], pacer_rate(&game_pacer));
+        } else print_pacing(con, client);
+
+    } else if (strcmp(verb, "raystats") == 0) {
+#if RAY_STATS
+        if (strcmp(name, "reset") == 0) ray_stats_reset(&game_render.ray_counts);
+        else print_ray_stats(con, client, &game_render.ray_counts);
+#else
+        console_print(con, client, "built without RAY_STATS");
+#endif
+
+    } else if (strcmp(verb, "viewbench") == 0) { /* Bot views at random open spots, cast as one batch and then one by one */
+        int v[3] = {MAX_VIEWS, 64, game_render.view_threads};
+        sscanf(cmd->line, "%*s %d %d %d", &v[0], &v[1], &v[2]);
+        int num_views = SDL_min(SDL_max(v[0], 1), MAX_VIEWS), columns = SDL_max(v[1], 1), threads = v[2];
+        view_batch all = {0}, one = {0};
+        Uint32 seed = 12345;
+        for (int i = 0; i < num_views; i++) {
+            xy cell;
+            if (!random_open_cell(&view_world, &seed, &cell)) {
+                console_print(con, client, "no open cells to view from");
+                view_batch_free(&all);
+                return;
+            }
+            int x = (cell.x * GRID_SPACING) + (next_random(&seed) % GRID_SPACING);
+            int y = (cell.y * GRID_SPACING) + (next_random(&seed) % GRID_SPACING);
+#if FIXED_MATH
+            column_pose pose = {int_fx(x), int_fx(y), next_random(&seed) % FX_TWO_PI};
+#else
+            column_pose pose = {x, y, (next_random(&seed) % 1000000) * (M_PI * 2 / 1000000)};
+#endif
+            view_batch_add(&all, pose, (SDL_Rect) {0, 0, columns, columns}, columns);
+        }
+        Uint64 batched = 0, separate = 0;
+        for (int r = 0; r < 20; r++) {
+            Uint64 start = SDL_GetPerformanceCounter();
+            view_batch_cast(&all, &view_world, threads, NULL);
+            batched += SDL_GetPerformanceCounter() - start;
+            start = SDL_GetPerformanceCounter();
+            for (int i = 0; i < num_views; i++) {
+                one.num_views = 0;
+                view_batch_add(&one, all.views[i].pose, all.views[i].viewport, columns);
+                view_batch_cast(&one, &view_world, threads, NULL);
+            }
+            separate += SDL_GetPerformanceCounter() - start;
+        }
+        double freq = SDL_GetPerformanceFrequency() / 1000.0;
+        console_print(con, client, "%d views x %d columns: batched %.3f ms, one by one %.3f ms", num_views, columns,
+            (batched / freq) / 20, (separate / freq) / 20);
+        view_batch_free(&all);
+        view_batch_free(&one);
+
+    } else if (strcmp(verb, "view") == 0) {
+        game_render.render_in_first_person = !game_render.render_in_first_person;
+
+    } else if (strcmp(verb, "reset") == 0) {
+        reset_grid_cam(&game_camera);
+        reset_player(&game_world.player);
+
+    } else if (strcmp(verb, "pause") == 0) {
+        game_pipe.paused = TRUE;
+        game_pipe.steps = 0;
+
+    } else if (strcmp(verb, "resume") == 0) {
+        game_pipe.paused = FALSE;
+
+    } else if (strcmp(verb, "step") == 0) { /* Advance frames one render frame at a time, then stay paused */
+        game_pipe.paused = TRUE;
+        game_pipe.steps += args >= 2 ? max(atoi(name), 1) : 1;
+
+    } else if (strcmp(verb, "profile") == 0) {
+        print_profile(con, client);
+
+    } else if (strcmp(verb, "quit") == 0) {
+        game_is_running = FALSE;
+
+    } else console_print(con, client, "unknown command '%s', try help", verb);
 }
 
-void add_fill_dgp(int x, int y, rgb color) {
-    new_dgp(x, y, color, &fill_dgp_head, &fill_dgp_tail);
-    num_fill_dgps++;
-    if (num_fill_dgps > max_fill_dgps) {
-        struct debug_grid_point* old_head = fill_dgp_head;
-        fill_dgp_head = fill_dgp_head->next;
-        free(old_head);
+void run_console_commands(console* con) {
+    for (int i = 0; i < con->num_queued; i++) {
+        if (game_record.f) replay_record_command(&game_record, con->queue[i].line);
+        run_console_command(&con->queue[i]);
     }
+    con->num_queued = 0;
 }
 
-void add_temp_dgp(int x, int y, rgb color) {
-    new_dgp(x, y, color, &temp_dgp_head, &temp_dgp_tail);
+void setup_console_vars(void) {
+    /* Set up variable label structs */
+    struct int_varlabel new_int_vls[INT_VLS_LEN] = {
+        {"grid camera x", &game_camera.x},
+        {"grid camera y", &game_camera.y},
+        {"grid camera zoom", &game_camera.zoom},
+        {"grid show crosshairs", &game_render.show_grid_crosshairs},
+        {"grid cam follows player", &game_camera.follow_player},
+        {"grid show player vision", &game_render.show_player_vision},
+        {"show player trail", &game_world.show_player_trail},
+        {"grid show grid", &game_render.show_grid_lines},
+        {"render walls", &game_render.fp_show_walls},
+        {"render first person", &game_render.render_in_first_person},
+        {"render brightness", &game_render.fp_brightness},
+        {"player max velocity", &game_world.player.max_velocity},
+        {"render lighting", &game_render.fp_lighting},
+        {"grid show lighting", &game_render.show_grid_lighting},
+        {"light ambient", &game_render.lighting.ambient},
+        {"grid show ray heatmap", &game_render.show_ray_heatmap},
+        {"render split views", &game_render.split_views},
+        {"render view threads", &game_render.view_threads}
+    };
+    for (int i = 0; i < INT_VLS_LEN; i++) int_vls[i] = new_int_vls[i];
+
+    struct flt_varlabel new_flt_vls[FLT_VLS_LEN] = {
+        {"player x", &game_world.player.x},
+        {"player y", &game_world.player.y},
+        {"player angle", &game_world.player.angle},
+        {"render scale", &game_render.fp_scale}
+    };
+    for (int i = 0; i < FLT_VLS_LEN; i++) flt_vls[i] = new_flt_vls[i];
 }
 
 
-const Uint8 *state;
 /* Engine Functions */
-void setup(void) {
-    bit_rep_init();
 
-    state = SDL_GetKeyboardState(NULL);
-
-    grid_length = 16;
-    grid_height = grid_length;
+/* Walled square of scattered pillars, the same every run, with the spawn area kept clear */
+void generate_map(world* w, int length, int height) {
+    Uint32 seed = 12345;
+    world_init(w, length, height);
+    for (int row = 0; row < height; row++) {
+        for (int col = 0; col < length; col++) {
+            int roll = (next_random(&seed) >> 8) % 100; /* Drawn for every cell, edges too, so the map stays the same */
+            int edge = row == 0 || col == 0 || row == height - 1 || col == length - 1;
+            set_grid_bool(w, col, row, edge || roll < 20);
+        }
+    }
+    world_fill_cells(w, 3, 3, 5, 5, FALSE);
+}
 
-    grid_enc = (bool_cont *) malloc(ceil( (float) ((grid_length * grid_height) / SIZE_BOOL_CONT) ));
+/* Walls of several heights and materials around the built in map's open room, for the wall layer */
+void raise_demo_walls(world* w) {
+    world_fill_walls(w, 5, 8, 6, 8, 2, 1); /* Ledge */
+    world_fill_walls(w, 7, 10, 7, 11, 5, 2); /* Waist high block */
+    world_fill_walls(w, 3, 11, 3, 13, 4, 4);
+    world_fill_walls(w, 9, 5, 9, 10, 12, 3); /* Taller than the outer walls */
+}
 
+/* Loads a generated map_size square map, or the built in one for 0 */
+void setup(world* w, camera* cam, int map_size) {
     int new_grid[16][16] = {
         {1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1},
         {1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,1},
@@ -637,205 +856,221 @@ void setup(void) {
         {1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1}
     };
 
-    for (int row = 0; row < grid_height; row++) {
-        for (int col = 0; col < grid_length; col++) {
-            bit_assign(
-                &grid_enc[((grid_length * row) + col) / (SIZE_BOOL_CONT * 8)],
-                ((grid_length * row) + col) % (SIZE_BOOL_CONT * 8),
-                new_grid[row][col]
-            );
+    if (map_size) {
+        generate_map(w, map_size, map_size);
+    } else {
+        world_init(w, 16, 16);
+
+        for (int row = 0; row < w->grid_height; row++) {
+            for (int col = 0; col < w->grid_length; col++) {
+                set_grid_bool(w, col, row, new_grid[row][col]);
+            }
         }
     }
 
-    reset_player();
-    reset_grid_cam();
-    grid_cam_zoom_p = perc(grid_cam_zoom);
-    calc_grid_cam_center();
+    reset_player(&w->player);
+#if FIXED_MATH
+    sync_fx_player(&w->player);
+#endif
 
-    /* Set up variable label structs */
-    struct int_varlabel new_int_vls[INT_VLS_LEN] = {
-        {"grid camera x", &grid_cam_x},
-        {"grid camera y", &grid_cam_y},
-        {"grid camera zoom", &grid_cam_zoom},
-        {"grid show crosshairs", &show_grid_crosshairs},
-        {"grid cam follows player", &grid_follow_player},
-        {"grid show player vision", &show_player_vision},
-        {"show player trail", &show_player_trail},
-        {"grid show grid", &show_grid_lines},
-        {"render walls", &fp_show_walls}
-    };
-    for (int i = 0; i < INT_VLS_LEN; i++) int_vls[i] = new_int_vls[i];
+    if (cam) {
+        reset_grid_cam(cam);
+        cam->follow_player = TRUE;
+        calc_grid_cam_center(cam);
+    }
+}
 
-    struct flt_varlabel new_flt_vls[FLT_VLS_LEN] = {
-        {"player x", &player_x},
-        {"player y", &player_y},
-        {"player angle", &player_angle}
-    };
-    for (int i = 0; i < FLT_VLS_LEN; i++) flt_vls[i] = new_flt_vls[i];
+Uint8 prev_state[SDL_NUM_SCANCODES];
+int key_just_pressed(int scancode) {
+    return input.keys[scancode] && !prev_state[scancode];
+}
 
-    /* Set up debug menus for varlabels */
-    for (int i = 0; i < INT_VLS_LEN; i++) strcpy(int_vls_menu[i], int_vls[i].label);
-    strcpy(int_vls_menu[INT_VLS_LEN], "end");
+void wait_for_frame(void) {
+    // Milliseconds since the last frame, update turns them into its delta time
+    last_frame_ticks = pacer_wait(&game_pacer);
+}
 
-    for (int i = 0; i < FLT_VLS_LEN; i++) strcpy(flt_vls_menu[i], flt_vls[i].label);
-    strcpy(flt_vls_menu[FLT_VLS_LEN], "end");
+void process_input(frame_pipeline* pipe, camera* cam) {
+    const Uint8* state = input.keys;
+    player_controls* c = &pipe->controls;
 
-}
+    input_poll(&input);
 
-Uint8 prev_state[SDL_NUM_SCANCODES];
-int key_just_pressed(int scancode) {
-    return state[scancode] && !prev_state[scancode];
-}
-
-void process_input(void) {
-    SDL_Event event;
-    SDL_PollEvent(&event);
-
-    switch (event.type) {
-        case SDL_QUIT:
-            game_is_running = FALSE;
-            break;
-        case SDL_MOUSEBUTTONUP:
-            if (event.button.button == SDL_BUTTON_LEFT) left_mouse_down = FALSE;
-            break;
-        case SDL_MOUSEBUTTONDOWN:
-            if (event.button.button == SDL_BUTTON_LEFT) left_mouse_down = TRUE;
-            break;
-        case SDL_MOUSEWHEEL:
-            zoom_grid_cam_center(-event.wheel.y);
-            break;
-        case SDL_MOUSEMOTION:
-            if (prev_mouse_x != -1 && prev_mouse_y != -1 && left_mouse_down) {
-                grid_cam_x -= round( (event.motion.x - prev_mouse_x) * (1.0f / grid_cam_zoom_p) );
-                grid_cam_y -= round( (event.motion.y - prev_mouse_y) * (1.0f / grid_cam_zoom_p) );
-            }
-            prev_mouse_x = event.motion.x;
-            prev_mouse_y = event.motion.y;
+    if (input.quit) game_is_running = FALSE;
+    if (input.wheel_y) zoom_grid_cam_center(cam, -input.wheel_y);
+    if (input.drag_x || input.drag_y) {
+        cam->x -= round( input.drag_x * (1.0f / cam->zoom_p) );
+        cam->y -= round( input.drag_y * (1.0f / cam->zoom_p) );
     }
 
-    shift = state[SDL_SCANCODE_LSHIFT];
+    game_render.shift_held = state[SDL_SCANCODE_LSHIFT];
 
-    if (state[SDL_SCANCODE_ESCAPE]) game_is_running = FALSE;
-    if (state[SDL_SCANCODE_RETURN] && !debug_menu_was_open) open_debug_menu = TRUE;
+    /* While the console is open the keyboard types into it instead of driving the game */
+    int typing = game_console.open;
+    if (typing) console_edit(&game_console, &input);
+    else if (key_just_pressed(SDL_SCANCODE_RETURN) || key_just_pressed(SDL_SCANCODE_GRAVE)) console_toggle(&game_console);
+    else if (key_just_pressed(SDL_SCANCODE_ESCAPE)) game_is_running = FALSE;
 
-    if (state[SDL_SCANCODE_RIGHT]) rotation_input++;
-    if (state[SDL_SCANCODE_LEFT]) rotation_input--;
+    SDL_LockMutex(pipe->sim_lock);
+    c->rotation = typing ? 0 : state[SDL_SCANCODE_RIGHT] - state[SDL_SCANCODE_LEFT];
+    c->vertical = typing ? 0 : state[SDL_SCANCODE_W] - state[SDL_SCANCODE_S];
+    c->horizontal = typing ? 0 : state[SDL_SCANCODE_D] - state[SDL_SCANCODE_A];
 
-    if (state[SDL_SCANCODE_R]) {
-        reset_grid_cam();
-        reset_player();
+    if (!typing && state[SDL_SCANCODE_R]) {
+        reset_grid_cam(cam);
+        c->reset = TRUE;
     }
-    if (key_just_pressed(SDL_SCANCODE_P)) print_debug();
+    SDL_UnlockMutex(pipe->sim_lock);
 
-    if (state[SDL_SCANCODE_W]) vertical_input++;
-    if (state[SDL_SCANCODE_S]) vertical_input--;
-    if (state[SDL_SCANCODE_A]) horizontal_input--;
-    if (state[SDL_SCANCODE_D]) horizontal_input++;
-
-    if (key_just_pressed(SDL_SCANCODE_M)) render_in_first_person = !render_in_first_person;
+    if (!typing) {
+        if (key_just_pressed(SDL_SCANCODE_P)) print_debug();
+        if (key_just_pressed(SDL_SCANCODE_M)) game_render.render_in_first_person = !game_render.render_in_first_person;
+    }
 
     memcpy(prev_state, state, sizeof(prev_state));
 }
 
-void update(void) {
-    int time_to_wait = FRAME_TARGET_TIME - (SDL_GetTicks() - last_frame_time);
+/* The lights placed around the built in map, shared by the game and the golden frames */
+void add_default_lights(lightmap* lm) {
+    lightmap_add_light(lm, GRID_SPACING * 4, GRID_SPACING * 4, 200, GRID_SPACING * 6);
+    lightmap_add_light(lm, GRID_SPACING * 13 + (GRID_SPACING / 2), GRID_SPACING * 2, 160, GRID_SPACING * 5);
+    lightmap_add_light(lm, GRID_SPACING * 7, GRID_SPACING * 12, 180, GRID_SPACING * 6);
+}
+
+/* Steps one world by delta_ticks milliseconds, cam may be NULL when nothing watches this world */
+void update(world* w, camera* cam, int delta_ticks) {
+    player* p = &w->player;
+
+#if FIXED_MATH
+    fixed fx_delta_time = (int_fx(delta_ticks) + 500) / 1000;
 
-    // Only delay if we are too fast to update this frame
-    if (time_to_wait > 0 && time_to_wait <= FRAME_TARGET_TIME) {
-        SDL_Delay(time_to_wait);
+    sync_fx_player(p);
+    int prev_col_x = fx_int(p->fx_x);
+
+    push_player_forward_fx(p, p->movement_accel * p->vertical_input);
+    push_player_right_fx(p, p->movement_accel * p->horizontal_input);
+    rotate_player_fx(p, p->rotation_input * fx_mul(p->fx_angle_increment, fx_delta_time) * p->rotation_speed);
+
+    fixed max_vel = int_fx(p->max_velocity);
+    fixed speed = fx_length(p->fx_x_velocity, p->fx_y_velocity);
+    if (speed > max_vel) {
+        p->fx_x_velocity = (p->fx_x_velocity * max_vel) / speed;
+        p->fx_y_velocity = (p->fx_y_velocity * max_vel) / speed;
+        speed = max_vel;
+    }
+
+    if (!p->horizontal_input && !p->vertical_input && speed != 0) {
+        fixed decel = int_fx(p->movement_decel);
+        if (p->fx_x_velocity != 0) {
+            int vel_is_pos = p->fx_x_velocity > 0;
+            p->fx_x_velocity -= (p->fx_x_velocity * decel) / speed;
+            if (vel_is_pos && p->fx_x_velocity < 0) p->fx_x_velocity = 0;
+            else if (!vel_is_pos && p->fx_x_velocity > 0) p->fx_x_velocity = 0;
+        }
+        if (p->fx_y_velocity != 0) {
+            int vel_is_pos = p->fx_y_velocity > 0;
+            p->fx_y_velocity -= (p->fx_y_velocity * decel) / speed;
+            if (vel_is_pos && p->fx_y_velocity < 0) p->fx_y_velocity = 0;
+            else if (!vel_is_pos && p->fx_y_velocity > 0) p->fx_y_velocity = 0;
+        }
     }
-    // Get a delta time factor converted to seconds to be used to update my objects
-    float delta_time = (SDL_GetTicks() - last_frame_time) / 1000.0f;
 
-    if (open_debug_menu && !(debug_menu_was_open && !reopen_debug_menu)) debug_menu();
-    else debug_menu_was_open = FALSE;
+    p->fx_x += fx_mul(p->fx_x_velocity, fx_delta_time);
+    p->fx_y += fx_mul(p->fx_y_velocity, fx_delta_time);
 
-    static float prev_player_x;
-    static float prev_player_y;
+    int col_x = fx_int(p->fx_x);
+    int col_y = fx_int(p->fx_y);
+#else
+    float delta_time = delta_ticks / 1000.0f;
 
-    push_player_forward(player_movement_accel * vertical_input);
-    push_player_right(player_movement_accel * horizontal_input);
-    rotate_player(rotation_input * player_angle_increment * player_rotation_speed * delta_time);
+    push_player_forward(p, p->movement_accel * p->vertical_input);
+    push_player_right(p, p->movement_accel * p->horizontal_input);
+    rotate_player(p, p->rotation_input * p->angle_increment * p->rotation_speed * delta_time);
 
-    player_velocity_angle = atan(player_y_velocity / player_x_velocity);
-    if (player_x_velocity < 0) player_velocity_angle += M_PI;
+    p->velocity_angle = atan(p->y_velocity / p->x_velocity);
+    if (p->x_velocity < 0) p->velocity_angle += M_PI;
 
-    if (player_x_velocity != 0 || player_y_velocity != 0) {
-        if (player_x_velocity == 0) {
-            if (player_y_velocity > player_max_velocity) player_y_velocity = player_max_velocity;
-            else if (player_y_velocity < -player_max_velocity) player_y_velocity = -player_max_velocity;
+    if (p->x_velocity != 0 || p->y_velocity != 0) {
+        if (p->x_velocity == 0) {
+            if (p->y_velocity > p->max_velocity) p->y_velocity = p->max_velocity;
+            else if (p->y_velocity < -p->max_velocity) p->y_velocity = -p->max_velocity;
 
-        } else if (player_y_velocity == 0) {
-            if (player_x_velocity > player_max_velocity) player_x_velocity = player_max_velocity;
-            else if (player_x_velocity < -player_max_velocity) player_x_velocity = -player_max_velocity;
+        } else if (p->y_velocity == 0) {
+            if (p->x_velocity > p->max_velocity) p->x_velocity = p->max_velocity;
+            else if (p->x_velocity < -p->max_velocity) p->x_velocity = -p->max_velocity;
 
         } else {
-            if (sqrt( pow(player_x_velocity, 2) + pow(player_y_velocity, 2) ) > player_max_velocity) {
-                player_x_velocity = cos(player_velocity_angle) * player_max_velocity;
-                player_y_velocity = sin(player_velocity_angle) * player_max_velocity;
+            if (sqrt( pow(p->x_velocity, 2) + pow(p->y_velocity, 2) ) > p->max_velocity) {
+                p->x_velocity = cos(p->velocity_angle) * p->max_velocity;
+                p->y_velocity = sin(p->velocity_angle) * p->max_velocity;
             }
         }
     }
 
-    if (!horizontal_input && !vertical_input) {
-        if (player_x_velocity != 0) {
-            int vel_is_pos = player_x_velocity > 0;
-            player_x_velocity -= cos(player_velocity_angle) * player_movement_decel;
-            if (vel_is_pos && player_x_velocity < 0) player_x_velocity = 0;
-            else if (!vel_is_pos && player_x_velocity > 0) player_x_velocity = 0;
+    if (!p->horizontal_input && !p->vertical_input) {
+        if (p->x_velocity != 0) {
+            int vel_is_pos = p->x_velocity > 0;
+            p->x_velocity -= cos(p->velocity_angle) * p->movement_decel;
+            if (vel_is_pos && p->x_velocity < 0) p->x_velocity = 0;
+            else if (!vel_is_pos && p->x_velocity > 0) p->x_velocity = 0;
         }
-        if (player_y_velocity != 0) {
-            int vel_is_pos = player_y_velocity > 0;
-            player_y_velocity -= sin(player_velocity_angle) * player_movement_decel;
-            if (vel_is_pos && player_y_velocity < 0) player_y_velocity = 0;
-            else if (!vel_is_pos && player_y_velocity > 0) player_y_velocity = 0;
+        if (p->y_velocity != 0) {
+            int vel_is_pos = p->y_velocity > 0;
+            p->y_velocity -= sin(p->velocity_angle) * p->movement_decel;
+            if (vel_is_pos && p->y_velocity < 0) p->y_velocity = 0;
+            else if (!vel_is_pos && p->y_velocity > 0) p->y_velocity = 0;
         }
     }
 
-    prev_player_x = player_x;
-    prev_player_y = player_y;
-
-    player_x += player_x_velocity * delta_time;
-    player_y += player_y_velocity * delta_time;
-    assign_i_player_pos();
-
-    // Wall collisions
-    int northeast_collision = get_grid_bool_coords(player_x + player_radius, player_y - player_radius);
-    if (northeast_collision) puts("northeast coll");
-    int southeast_collision = get_grid_bool_coords(player_x + player_radius, player_y + player_radius);
-    if (southeast_collision) puts("southeast coll");
-    int southwest_collision = get_grid_bool_coords(player_x - player_radius, player_y + player_radius);
-    if (southwest_collision) puts("southwest coll");
-    int northwest_collision = get_grid_bool_coords(player_x - player_radius, player_y - player_radius);
-    if (northwest_collision) puts("northwest coll");
-/* 
+    int prev_col_x = p->x;
+
+    p->x += p->x_velocity * delta_time;
+    p->y += p->y_velocity * delta_time;
+
+    int col_x = p->x;
+    int col_y = p->y;
+#endif
+    int snap_x = FALSE;
+    int snap_y = FALSE;
+    int radius = p->radius;
+
+    // Wall collisions, all on whole units so both math modes collide identically
+    int northeast_collision = get_grid_bool_coords(w, col_x + radius, col_y - radius);
+    if (northeast_collision && w->log) puts("northeast coll");
+    int southeast_collision = get_grid_bool_coords(w, col_x + radius, col_y + radius);
+    if (southeast_collision && w->log) puts("southeast coll");
+    int southwest_collision = get_grid_bool_coords(w, col_x - radius, col_y + radius);
+    if (southwest_collision && w->log) puts("southwest coll");
+    int northwest_collision = get_grid_bool_coords(w, col_x - radius, col_y - radius);
+    if (northwest_collision && w->log) puts("northwest coll");
+/*
     if (northeast_collision || southeast_collision || southwest_collision || northwest_collision)
-    add_temp_dgp(i_player_x, i_player_y, C_PURPLE);
+    add_temp_dgp(w, p->i_x, p->i_y, C_PURPLE);
  */
     // North
     if (
         (
             northeast_collision && (
                 !(southeast_collision && !northwest_collision) || (
-                    player_x_velocity != 0 &&
-                    (( ((int) prev_player_x + player_radius) / GRID_SPACING ) == ( ((int) player_x + player_radius) / GRID_SPACING ))
+                    PLAYER_X_MOVING(p) &&
+                    (( (prev_col_x + radius) / GRID_SPACING ) == ( (col_x + radius) / GRID_SPACING ))
                 )
             )
         ) || (
             northwest_collision && (
                 !(southwest_collision && !northeast_collision) || (
-                    player_x_velocity != 0 &&
-                    (( ((int) prev_player_x - player_radius) / GRID_SPACING ) == ( ((int) player_x - player_radius) / GRID_SPACING ))
+                    PLAYER_X_MOVING(p) &&
+                    (( (prev_col_x - radius) / GRID_SPACING ) == ( (col_x - radius) / GRID_SPACING ))
                 )
             )
         )
     ) {
-        player_y = (((int) player_y / GRID_SPACING) * GRID_SPACING) + player_radius;
-        player_y_velocity = 0;
-        printf(
+        col_y = ((col_y / GRID_SPACING) * GRID_SPACING) + radius;
+        snap_y = TRUE;
+        if (w->log) printf(
             "north collision: east now_x (%d), east prev_x (%d)\n",
-            ((int) player_x + player_radius) / GRID_SPACING,
-            ((int) prev_player_x + player_radius) / GRID_SPACING
+            (col_x + radius) / GRID_SPACING,
+            (prev_col_x + radius) / GRID_SPACING
         );
         // open_debug_menu = TRUE;
     }
@@ -845,9 +1080,9 @@ void update(void) {
         (southeast_collision && !(northeast_collision && !southwest_collision)) ||
         (southwest_collision && !(northwest_collision && !southeast_collision))
     ) {
-        player_y = ((((int) player_y / GRID_SPACING) + 1) * GRID_SPACING) - player_radius;
-        player_y_velocity = 0;
-        puts("south collision");
+        col_y = (((col_y / GRID_SPACING) + 1) * GRID_SPACING) - radius;
+        snap_y = TRUE;
+        if (w->log) puts("south collision");
     }
 
     // East
@@ -855,9 +1090,9 @@ void update(void) {
         (northeast_collision && !(northwest_collision && !southeast_collision)) ||
         (southeast_collision && !(southwest_collision && !northeast_collision))
     ) {
-        player_x = ((((int) player_x / GRID_SPACING) + 1) * GRID_SPACING) - player_radius;
-        player_x_velocity = 0;
-        puts("east collision");
+        col_x = (((col_x / GRID_SPACING) + 1) * GRID_SPACING) - radius;
+        snap_x = TRUE;
+        if (w->log) puts("east collision");
     }
 
     // West
@@ -865,83 +1100,331 @@ void update(void) {
         (northwest_collision && !(northeast_collision && !southwest_collision)) ||
         (southwest_collision && !(southeast_collision && !northwest_collision))
     ) {
-        player_x = (((int) player_x / GRID_SPACING) * GRID_SPACING) + player_radius;
-        player_x_velocity = 0;
-        puts("west collision");
+        col_x = ((col_x / GRID_SPACING) * GRID_SPACING) + radius;
+        snap_x = TRUE;
+        if (w->log) puts("west collision");
+    }
+
+#if FIXED_MATH
+    if (snap_x) {
+        p->fx_x = int_fx(col_x);
+        p->fx_x_velocity = 0;
     }
+    if (snap_y) {
+        p->fx_y = int_fx(col_y);
+        p->fx_y_velocity = 0;
+    }
+    publish_fx_player(p);
+#else
+    if (snap_x) {
+        p->x = col_x;
+        p->x_velocity = 0;
+    }
+    if (snap_y) {
+        p->y = col_y;
+        p->y_velocity = 0;
+    }
+#endif
+    assign_i_player_pos(p);
 
-    if (show_player_trail) add_fill_dgp(player_x, player_y, C_YELLOW);
+    if (w->show_player_trail) add_fill_dgp(w, p->x, p->y, C_YELLOW);
 
-    if (grid_follow_player) {
-        grid_cam_x = round( player_x - ((WINDOW_WIDTH / 2) * (1.0f / grid_cam_zoom_p)) );
-        grid_cam_y = round( player_y - ((WINDOW_HEIGHT / 2) * (1.0f / grid_cam_zoom_p)) );
+    if (cam && cam->follow_player) camera_follow(cam, p);
+
+    if (w->log) {
+        printf("\nplayer pos: (%f, %f) facing %f (%d deg)\n", p->x, p->y, p->angle, rad_deg(p->angle));
+        printf("player velocity: (%f, %f)\n", p->x_velocity, p->y_velocity);
     }
 
-    printf("\nplayer pos: (%f, %f) facing %f (%d deg)\n", player_x, player_y, player_angle, rad_deg(player_angle));
-    printf("player velocity: (%f, %f)\n", player_x_velocity, player_y_velocity);
+    p->vertical_input = 0;
+    p->horizontal_input = 0;
+    p->rotation_input = 0;
+}
 
-    vertical_input = 0;
-    horizontal_input = 0;
-    rotation_input = 0;
+/* First Person Views */
 
-    last_frame_time = SDL_GetTicks();
+/* Sky, and the floor fading in from black past the render distance, for a view_width x view_height view */
+void draw_fp_background(render_ctx* rc, int view_width, int view_height) {
+    int distance_scr = (fp_render_distance_scr * view_height) / WINDOW_HEIGHT;
+    draw_rect_rgb(rc, 0, view_height / 2, view_width, view_height / 2, C_BLACK);
+    vertical_gradient(rc, 0, (view_height / 2) + ((view_height / 2) - distance_scr), view_width, distance_scr, C_BLACK, fp_bg_bottom);
+    draw_rect_rgb(rc, 0, 0, view_width, view_height / 2, fp_bg_top);
 }
 
-void render(void) {
-    set_draw_color_rgb(render_in_first_person ? fp_bg_top : grid_bg);
-    SDL_RenderClear(renderer);
+/*
+ * One wall span at x, width pixels wide, in a view_width x view_height view. Walls keep their
+ * proportions to the view's width, so a half width view shows them at half the height. A span only
+ * draws above *horizon and lowers it to its own top, horizon is NULL for a lone full height wall.
+ */
+#if FIXED_MATH
+void draw_wall_column(render_ctx* rc, int x, int width, int view_width, int view_height, wall_span* span, fixed ray_angle, column_pose eye, int* horizon) {
+    /* Distance along the view direction, the same fisheye correction as cos(ray - player) * length */
+    fx_xy fx_hit = span->hit;
+    float dist = fx_flt(fx_mul(fx_hit.x - eye.x, fx_cos(eye.angle)) + fx_mul(fx_hit.y - eye.y, fx_sin(eye.angle)));
+    xy hit = {fx_int(fx_hit.x), fx_int(fx_hit.y)};
+#else
+void draw_wall_column(render_ctx* rc, int x, int width, int view_width, int view_height, wall_span* span, float ray_angle, float eye_x, float eye_y,
+    float eye_angle, int* horizon) {
+    xy hit = span->hit;
+    float dist = cos(ray_angle - eye_angle) * sqrt( pow(hit.x - eye_x, 2) + pow(hit.y - eye_y, 2) );
+#endif
+    float scale = (float) view_width / WINDOW_WIDTH;
+    int height = (1.0f / (dist * rc->fp_scale)) * WINDOW_HEIGHT * scale;
+    int bottom = (view_height / 2) - (height / 2) + height;
+    int top = span->height == WALL_HEIGHT_FULL ? (view_height / 2) - (height / 2) : bottom - (int) (((long long) height * span->height) / WALL_HEIGHT_FULL);
+    if (horizon) {
+        bottom = span->top ? *horizon : SDL_min(bottom, *horizon);
+        *horizon = SDL_min(*horizon, top);
+        if (bottom <= top) return;
+    }
+
+    rgb base = span->material ? wall_materials[(int) span->material] : wall_color;
+    rgb new_wall_color = base;
+    if (rc->fp_lighting) {
+#if FIXED_MATH
+        int on_horizontal = (fx_hit.y & (FX_GRID_SPACING - 1)) == 0;
+        int forward = on_horizontal ? ray_angle < FX_PI : (ray_angle < FX_HALF_PI || ray_angle > FX_PI + FX_HALF_PI);
+#else
+        int on_horizontal = (hit.y & (GRID_SPACING - 1)) == 0;
+        int forward = on_horizontal ? ray_angle < M_PI : (ray_angle < M_PI / 2 || ray_angle > M_PI * 1.5);
+#endif
+        new_wall_color = light_rgb(base, lightmap_wall_level(&rc->lighting, hit.x, hit.y, on_horizontal, forward));
+    }
+    if (span->top) new_wall_color = brighten(new_wall_color, 24); /* Tops face the sky, a little lighter than the sides */
+    new_wall_color = brighten(new_wall_color, (float) -(dist / fp_render_distance) * rc->fp_brightness);
+    draw_rect_rgb(rc, x, top, width, bottom - top, new_wall_color);
+}
 
-    if (render_in_first_person) {
-        draw_rect_rgb(0, WINDOW_HEIGHT / 2, WINDOW_WIDTH, WINDOW_HEIGHT / 2, C_BLACK);
-        vertical_gradient(0, (WINDOW_HEIGHT / 2) + ((WINDOW_HEIGHT / 2) - fp_render_distance_scr), WINDOW_WIDTH, fp_render_distance_scr, C_BLACK, fp_bg_bottom);
-        draw_rect_rgb(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT / 2, fp_bg_top);
+/* A column's spans front to back, stopping once the column is covered */
+#if FIXED_MATH
+void draw_wall_spans(render_ctx* rc, int x, int width, int view_width, int view_height, wall_span* spans, int num_spans, fixed ray_angle, column_pose eye) {
+    int horizon = view_height;
+    for (int i = 0; i < num_spans && horizon > 0; i++) draw_wall_column(rc, x, width, view_width, view_height, &spans[i], ray_angle, eye, &horizon);
+}
+#else
+void draw_wall_spans(render_ctx* rc, int x, int width, int view_width, int view_height, wall_span* spans, int num_spans, float ray_angle,
+    float eye_x, float eye_y, float eye_angle) {
+    int horizon = view_height;
+    for (int i = 0; i < num_spans && horizon > 0; i++) {
+        draw_wall_column(rc, x, width, view_width, view_height, &spans[i], ray_angle, eye_x, eye_y, eye_angle, &horizon);
     }
+}
+#endif
+
+/* Draws each view of a cast batch into its viewport */
+void draw_view_batch(render_ctx* rc, view_batch* b) {
+    for (int v = 0; v < b->num_views; v++) {
+        view_camera* view = &b->views[v];
+        SDL_RenderSetViewport(rc->renderer, &view->viewport);
+        draw_fp_background(rc, view->viewport.w, view->viewport.h);
+        for (int c = 0; rc->fp_show_walls && c < view->columns; c++) {
+            int ray = b->first_ray[v] + c;
+            int x0 = (c * view->viewport.w) / view->columns;
+            int x1 = ((c + 1) * view->viewport.w) / view->columns;
+            wall_span lone = {b->hits[ray], WALL_HEIGHT_FULL};
+#if FIXED_MATH
+            if (b->num_spans) draw_wall_spans(rc, x0, x1 - x0, view->viewport.w, view->viewport.h, &b->spans[ray * MAX_WALL_SPANS], b->num_spans[ray],
+                view_ray_angle(view, c), view->pose);
+            else draw_wall_column(rc, x0, x1 - x0, view->viewport.w, view->viewport.h, &lone, view_ray_angle(view, c), view->pose, NULL);
+#else
+            if (b->num_spans) draw_wall_spans(rc, x0, x1 - x0, view->viewport.w, view->viewport.h, &b->spans[ray * MAX_WALL_SPANS], b->num_spans[ray],
+                view_ray_angle(view, c), view->pose.x, view->pose.y, view->pose.angle);
+            else draw_wall_column(rc, x0, x1 - x0, view->viewport.w, view->viewport.h, &lone, view_ray_angle(view, c),
+                view->pose.x, view->pose.y, view->pose.angle, NULL);
+#endif
+        }
+    }
+    SDL_RenderSetViewport(rc->renderer, NULL);
+}
+
+/* Nearest open cell to (x, y) by growing rings, the center of it in world coordinates */
+xy nearest_open_point(world* w, int x, int y) {
+    for (int r = 0; r < SDL_max(w->grid_length, w->grid_height); r++) {
+        for (int cy = y - r; cy <= y + r; cy++) {
+            for (int cx = x - r; cx <= x + r; cx++) {
+                if ((abs(cx - x) == r || abs(cy - y) == r) && in_grid(w, cx, cy) && !get_grid_bool(w, cx, cy)) {
+                    return (xy) {(cx * GRID_SPACING) + (GRID_SPACING / 2), (cy * GRID_SPACING) + (GRID_SPACING / 2)};
+                }
+            }
+        }
+    }
+    return (xy) {x * GRID_SPACING, y * GRID_SPACING};
+}
+
+/* A spectator camera standing in an open cell near a quarter point of the map, turned to face the player */
+column_pose spectator_pose(world* w, int k) {
+    int qx = (k & 1) ? 3 : 1, qy = (k & 2) ? 3 : 1;
+    xy at = nearest_open_point(w, (w->grid_length * qx) / 4, (w->grid_height * qy) / 4);
+    float angle = atan2(w->player.y - at.y, w->player.x - at.x);
+    if (angle < 0) angle += M_PI * 2;
+#if FIXED_MATH
+    return (column_pose) {int_fx(at.x), int_fx(at.y), fx_wrap_angle(flt_fx(angle))};
+#else
+    return (column_pose) {at.x, at.y, angle};
+#endif
+}
+
+/* Split screen, the player's view then spectators, two side by side or four in a grid, cast as one batch */
+void render_split_views(world* w, render_ctx* rc) {
+    player* p = &w->player;
+    int n = SDL_min(rc->split_views, 4);
+    int cols = 2, rows = n == 2 ? 1 : 2;
+    view_batch* b = &rc->views;
+
+    b->num_views = 0;
+    for (int v = 0; v < n; v++) {
+        SDL_Rect viewport = {
+            ((v % cols) * WINDOW_WIDTH) / cols, ((v / cols) * WINDOW_HEIGHT) / rows,
+            WINDOW_WIDTH / cols, WINDOW_HEIGHT / rows
+        };
+#if FIXED_MATH
+        column_pose pose = v == 0 ? (column_pose) {p->fx_x, p->fx_y, p->fx_angle} : spectator_pose(w, v - 1);
+#else
+        column_pose pose = v == 0 ? (column_pose) {round(p->x), round(p->y), p->angle} : spectator_pose(w, v - 1);
+#endif
+        view_batch_add(b, pose, viewport, viewport.w);
+    }
+
+    if (rc->fp_lighting) lightmap_sync(&rc->lighting, w);
+    rc->ray_counts.frames++;
+    view_batch_cast(b, w, rc->view_threads, &rc->ray_counts);
+    draw_view_batch(rc, b);
+    rc->columns.valid = FALSE; /* The single view's columns weren't kept up while split */
+}
+
+void render(world* w, camera* cam, render_ctx* rc) {
+    player* p = &w->player;
+
+    set_draw_color_rgb(rc, rc->render_in_first_person ? fp_bg_top : grid_bg);
+    SDL_RenderClear(rc->renderer);
+
+    if (rc->render_in_first_person && rc->split_views > 1) render_split_views(w, rc);
+    else if (rc->render_in_first_person || rc->show_player_vision) {
+        if (rc->render_in_first_person) draw_fp_background(rc, WINDOW_WIDTH, WINDOW_HEIGHT);
+#if FIXED_MATH
+        column_pose pose = {p->fx_x, p->fx_y, p->fx_angle};
+#else
+        column_pose pose = {round(p->x), round(p->y), p->angle};
+#endif
+        /* Tracing wants every ray's debug points, so it always casts. Walls of different heights are cast as spans every frame */
+        int layered = w->wall_layer && rc->render_in_first_person && rc->fp_show_walls;
+        int reuse = !rc->show_player_vision && !layered && column_cache_matches(&rc->columns, pose);
+        if (rc->render_in_first_person && rc->fp_lighting) lightmap_sync(&rc->lighting, w);
+        ray_stats_bind(&rc->ray_counts);
+        rc->ray_counts.frames++;
 
-    if (render_in_first_person || show_player_vision) {
         for (int ray_i = 0; ray_i < WINDOW_WIDTH; ray_i++) {
-            float ray_angle = (player_angle - (FOV / 2)) + ((FOV / WINDOW_WIDTH) * ray_i);
+#if FIXED_MATH
+            fixed ray_angle = fx_wrap_angle((p->fx_angle - (FX_FOV / 2)) + ((FX_FOV * ray_i) / WINDOW_WIDTH));
+#else
+            float ray_angle = (p->angle - (FOV / 2)) + ((FOV / WINDOW_WIDTH) * ray_i);
             if (ray_angle < 0) ray_angle += M_PI * 2;
             else if (ray_angle >= M_PI * 2) ray_angle -= M_PI * 2;
-            xy hit = raycast(round(player_x), round(player_y), ray_angle);
-
-            if (render_in_first_person && fp_show_walls) {
-                float dist = cos(ray_angle - player_angle) * sqrt( pow(hit.x - player_x, 2) + pow(hit.y - player_y, 2) );
-                int height = (1.0f / (dist * fp_scale)) * WINDOW_HEIGHT;
-                rgb new_wall_color = brighten(wall_color, (float) -(dist / fp_render_distance) * fp_brightness);
-                draw_rect_rgb(ray_i, (WINDOW_HEIGHT / 2) - (height / 2), 1, height, new_wall_color);
+#endif
+            if (layered) {
+                wall_span spans[MAX_WALL_SPANS];
+                int num_spans = raycast_spans(w, pose.x, pose.y, ray_angle, spans);
+#if FIXED_MATH
+                draw_wall_spans(rc, ray_i, 1, WINDOW_WIDTH, WINDOW_HEIGHT, spans, num_spans, ray_angle, pose);
+#else
+                draw_wall_spans(rc, ray_i, 1, WINDOW_WIDTH, WINDOW_HEIGHT, spans, num_spans, ray_angle, p->x, p->y, p->angle);
+#endif
+                continue;
+            }
 
-            } else if (show_player_vision) add_temp_dgp(hit.x, hit.y, C_WHITE);
+            if (!reuse || column_stale(&rc->columns, w, ray_i)) {
+                rc->columns.hits[ray_i] = raycast(w, pose.x, pose.y, ray_angle, rc->show_player_vision);
+            }
+#if FIXED_MATH
+            fx_xy fx_hit = rc->columns.hits[ray_i];
+            xy hit = {fx_int(fx_hit.x), fx_int(fx_hit.y)};
+#else
+            xy hit = rc->columns.hits[ray_i];
+#endif
+
+            if (rc->render_in_first_person && rc->fp_show_walls) {
+                wall_span lone = {rc->columns.hits[ray_i], WALL_HEIGHT_FULL};
+#if FIXED_MATH
+                draw_wall_column(rc, ray_i, 1, WINDOW_WIDTH, WINDOW_HEIGHT, &lone, ray_angle, pose, NULL);
+#else
+                draw_wall_column(rc, ray_i, 1, WINDOW_WIDTH, WINDOW_HEIGHT, &lone, ray_angle, p->x, p->y, p->angle, NULL);
+#endif
+            } else if (rc->show_player_vision) add_temp_dgp(w, hit.x, hit.y, C_WHITE);
         }
+        if (layered) rc->columns.valid = FALSE;
+        else column_cache_commit(&rc->columns, w, pose);
+        ray_stats_bind(NULL);
     }
 
-    if (!render_in_first_person) { /* Map View */
+    if (!rc->render_in_first_person) { /* Map View */
         /* Grid */
-        
-        /* Fill */
-        for (int row = 0; row < grid_height; row++) {
-            for (int col = 0; col < grid_length; col++) {
-                g_draw_rect_rgb(col * GRID_SPACING, row * GRID_SPACING, GRID_SPACING, GRID_SPACING,
-                get_grid_bool(col, row) ? grid_fill_solid : grid_fill_nonsolid);
+        cell_box view = visible_cells(cam, w);
+
+        /* Fill, as LOD tiles or else one rect per run of equal cells */
+        if (!lod_draw(&rc->map_lod, rc->renderer, cam, w, grid_fill_nonsolid, grid_fill_solid)) {
+            map_view_sync(&rc->map_view, w);
+            for (int row = view.y0; row <= view.y1; row++) {
+                cell_run* runs = &rc->map_view.runs[row * w->grid_length];
+                for (int i = 0; i < rc->map_view.num_runs[row]; i++) {
+                    g_draw_rect_rgb(rc, cam, runs[i].start * GRID_SPACING, row * GRID_SPACING, runs[i].length * GRID_SPACING, GRID_SPACING,
+                    runs[i].solid ? grid_fill_solid : grid_fill_nonsolid);
+                }
             }
         }
 
-        if (show_grid_lines) {
+        /* Baked floor light, darkening each open cell by how far it falls short of neutral */
+        if (rc->show_grid_lighting) {
+            lightmap_sync(&rc->lighting, w);
+            SDL_SetRenderDrawBlendMode(rc->renderer, SDL_BLENDMODE_BLEND);
+            for (int row = view.y0; row <= view.y1; row++) {
+                for (int col = view.x0; col <= view.x1; col++) {
+                    if (get_grid_bool(w, col, row)) continue;
+                    int shade = LIGHT_NEUTRAL - lightmap_floor_level(&rc->lighting, col, row);
+                    int real_size = ceil(GRID_SPACING * cam->zoom_p);
+                    draw_rect_a_rgb(rc, round(((col * GRID_SPACING) - cam->x) * cam->zoom_p), round(((row * GRID_SPACING) - cam->y) * cam->zoom_p),
+                        real_size, real_size, shade > 0 ? C_BLACK : C_YELLOW, SDL_min(abs(shade) * 2, 255));
+                }
+            }
+            SDL_SetRenderDrawBlendMode(rc->renderer, SDL_BLENDMODE_NONE);
+        }
+
+#if RAY_STATS
+        /* Where rays stop, on a square root scale so the rarely hit cells still show */
+        if (rc->show_ray_heatmap && rc->ray_counts.cell_hits && rc->ray_counts.grid_length == w->grid_length && rc->ray_counts.grid_height == w->grid_height) {
+            Uint32 most = ray_stats_max_hits(&rc->ray_counts);
+            int real_size = ceil(GRID_SPACING * cam->zoom_p);
+            SDL_SetRenderDrawBlendMode(rc->renderer, SDL_BLENDMODE_BLEND);
+            for (int row = view.y0; row <= view.y1; row++) {
+                for (int col = view.x0; col <= view.x1; col++) {
+                    Uint32 hits = rc->ray_counts.cell_hits[(row * w->grid_length) + col];
+                    if (!hits) continue;
+                    double heat = sqrt((double) hits / most);
+                    rgb color = {255, 255 - (heat * 255), 0};
+                    draw_rect_a_rgb(rc, round(((col * GRID_SPACING) - cam->x) * cam->zoom_p), round(((row * GRID_SPACING) - cam->y) * cam->zoom_p),
+                        real_size, real_size, color, 80 + (heat * 175));
+                }
+            }
+            SDL_SetRenderDrawBlendMode(rc->renderer, SDL_BLENDMODE_NONE);
+        }
+#endif
+
+        if (rc->show_grid_lines && GRID_SPACING * cam->zoom_p >= 4) { /* Any denser and the lines are all there is to see */
             /* Vertical lines */
-            for (int i = 0; i < grid_length + 1; i++) {
-                g_draw_rect_rgb(
-                    (i * GRID_SPACING) - ceil(grid_line_width / 2), 
+            for (int i = view.x0; i <= view.x1 + 1; i++) {
+                g_draw_rect_rgb(rc, cam,
+                    (i * GRID_SPACING) - ceil(grid_line_width / 2),
                     0,
                     grid_line_width,
-                    grid_height * GRID_SPACING,
+                    w->grid_height * GRID_SPACING,
                     grid_line_fill
                 );
             }
             /* Horizontal lines */
-            for (int i = 0; i < grid_length + 1; i++) {
-                g_draw_rect_rgb(
+            for (int i = view.y0; i <= view.y1 + 1; i++) {
+                g_draw_rect_rgb(rc, cam,
                     0,
                     (i * GRID_SPACING) - ceil(grid_line_width / 2),
-                    grid_length * GRID_SPACING,
+                    w->grid_length * GRID_SPACING,
                     grid_line_width,
                     grid_line_fill
                 );
@@ -949,71 +1432,840 @@ void render(void) {
         }
 
         /* Fill DGPs */
-        for (struct debug_grid_point* p_i = fill_dgp_head; p_i; p_i = p_i->next) {
-            g_draw_point_rgb(p_i->x, p_i->y, dgp_radius, p_i->color);
+        for (struct debug_grid_point* p_i = w->fill_dgp_head; p_i; p_i = p_i->next) {
+            g_draw_point_rgb(rc, cam, p_i->x, p_i->y, dgp_radius, p_i->color);
+        }
+
+        /* Path from the console */
+        set_draw_color_rgb(rc, C_BLUE);
+        for (int i = 0; i < rc->shown_path_len; i++) {
+            int x = (rc->shown_path[i].x * GRID_SPACING) + (GRID_SPACING / 2);
+            int y = (rc->shown_path[i].y * GRID_SPACING) + (GRID_SPACING / 2);
+            if (i) {
+                int px = (rc->shown_path[i - 1].x * GRID_SPACING) + (GRID_SPACING / 2);
+                int py = (rc->shown_path[i - 1].y * GRID_SPACING) + (GRID_SPACING / 2);
+                SDL_RenderDrawLine(rc->renderer, round((px - cam->x) * cam->zoom_p), round((py - cam->y) * cam->zoom_p),
+                    round((x - cam->x) * cam->zoom_p), round((y - cam->y) * cam->zoom_p));
+            }
+            g_draw_point_rgb(rc, cam, x, y, dgp_radius, C_BLUE);
         }
 
         /* Player */
-        g_draw_point_rgb( // Player pointer
-            player_x + round(cos(player_angle) * grid_player_pointer_dist),
-            player_y + round(sin(player_angle) * grid_player_pointer_dist),
-            player_radius * perc(grid_player_pointer_radius_offset),
+        g_draw_point_rgb(rc, cam, // Player pointer
+            p->x + round(cos(p->angle) * grid_player_pointer_dist),
+            p->y + round(sin(p->angle) * grid_player_pointer_dist),
+            p->radius * perc(grid_player_pointer_radius_offset),
             grid_player_fill
         );
-        g_draw_point_rgb(player_x, player_y, player_radius, grid_player_fill); // Player
+        g_draw_point_rgb(rc, cam, p->x, p->y, p->radius, grid_player_fill); // Player
 
         /* Temp DGPs */
-        for (struct debug_grid_point* p_i = temp_dgp_head; p_i; p_i = p_i->next) {
-            g_draw_point_rgb(p_i->x, p_i->y, dgp_radius, p_i->color);
+        for (struct debug_grid_point* p_i = w->temp_dgp_head; p_i; p_i = p_i->next) {
+            g_draw_point_rgb(rc, cam, p_i->x, p_i->y, dgp_radius, p_i->color);
         }
 
-        if (show_grid_crosshairs) {
-            draw_rect_rgb(WINDOW_WIDTH / 2, 0, 1, WINDOW_HEIGHT, C_WHITE);
-            draw_rect_rgb(0, WINDOW_HEIGHT / 2, WINDOW_WIDTH, 1, C_WHITE);
+        if (rc->show_grid_crosshairs) {
+            draw_rect_rgb(rc, WINDOW_WIDTH / 2, 0, 1, WINDOW_HEIGHT, C_WHITE);
+            draw_rect_rgb(rc, 0, WINDOW_HEIGHT / 2, WINDOW_WIDTH, 1, C_WHITE);
         }
     }
 
-    struct debug_grid_point* p_i = temp_dgp_head;
-    while (p_i) {
-        struct debug_grid_point* next = p_i->next;
-        free(p_i);
-        p_i = next;
-    }
+    clear_temp_dgps(w);
+
+    if (rc->con && rc->con->open) draw_console(rc, rc->con);
+
+    if (rc->shift_held) draw_rect(rc, 25, 25, 50, 50, 200, 55, 55);
+
+    if (rc->capture && rc->capture->thread) capture_frame(rc->capture, rc->renderer);
+    SDL_RenderPresent(rc->renderer);
+}
 
-    temp_dgp_head = NULL;
-    temp_dgp_tail = NULL;
+/* Scrollback and edit line along the bottom of the window */
+void draw_console(render_ctx* rc, console* con) {
+    int line_height = (FONT_HEIGHT + 3) * console_text_scale;
+    int height = (CONSOLE_HISTORY + 1) * line_height + 8;
+    int y = WINDOW_HEIGHT - height;
+    char prompt[CONSOLE_LINE_LEN + 3];
 
-    if (shift) draw_rect(25, 25, 50, 50, 200, 55, 55);
+    SDL_SetRenderDrawBlendMode(rc->renderer, SDL_BLENDMODE_BLEND);
+    draw_rect_a_rgb(rc, 0, y, WINDOW_WIDTH, height, C_BLACK, 180);
+    SDL_SetRenderDrawBlendMode(rc->renderer, SDL_BLENDMODE_NONE);
 
-    SDL_RenderPresent(renderer);
+    for (int i = 0; i < CONSOLE_HISTORY; i++) {
+        char* line = con->history[(con->history_next + i) % CONSOLE_HISTORY];
+        draw_text(rc, 4, y + 4 + (i * line_height), console_text_scale, line, C_WHITE);
+    }
+    snprintf(prompt, sizeof(prompt), "] %s_", con->edit);
+    draw_text(rc, 4, y + 4 + (CONSOLE_HISTORY * line_height), console_text_scale, prompt, C_YELLOW);
 }
 
 void free_memory(void) {
-    free(grid_enc);
+    world_free(&game_world);
+    world_free(&view_world);
+    pathfinder_free(&game_paths);
+}
+
+/* Pipelined Simulation */
+
+/* One simulation step and its snapshot, the caller holds sim_lock */
+void sim_tick(frame_pipeline* pipe, int delta_ticks) {
+    player* p = &pipe->w->player;
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    if (game_record.f) replay_record_tick(&game_record, pipe->controls, delta_ticks);
+    if (pipe->controls.reset) {
+        reset_player(p);
+        pipe->controls.reset = FALSE;
+    }
+    p->horizontal_input = pipe->controls.horizontal;
+    p->vertical_input = pipe->controls.vertical;
+    p->rotation_input = pipe->controls.rotation;
+
+    update(pipe->w, NULL, delta_ticks);
+    if (game_record.f && game_record.ticks % REPLAY_CHECK_INTERVAL == 0) replay_record_check(&game_record, REPLAY_CHECK, world_hash(pipe->w, FALSE));
+
+    snapshot_capture(&pipe->slots[pipe->back], pipe->w, pipe->frame++, pipe->keep_dirty);
+    pipeline_publish(pipe);
+
+    pipe->sim_time += SDL_GetPerformanceCounter() - start;
+    pipe->sim_ticks++;
+}
 
-    struct debug_grid_point* p_i = fill_dgp_head;
-    while (p_i) {
-        struct debug_grid_point* next = p_i->next;
-        free(p_i);
-        p_i = next;
+/* Ticks at the frame rate on its own, so the next frame simulates while the last one renders */
+int sim_thread(void* data) {
+    frame_pipeline* pipe = data;
+    frame_pacer pacer;
+    pacer_init(&pacer, PACE_FIXED, FPS, 0);
+
+    while (SDL_AtomicGet(&pipe->running)) {
+        int delta_ticks = pacer_wait(&pacer);
+
+        SDL_LockMutex(pipe->sim_lock);
+        if (!pipe->paused) sim_tick(pipe, delta_ticks);
+        SDL_UnlockMutex(pipe->sim_lock);
+    }
+    return 0;
+}
+
+void pipeline_start(frame_pipeline* pipe) {
+    SDL_AtomicSet(&pipe->running, TRUE);
+    pipe->thread = SDL_CreateThread(sim_thread, "simulation", pipe);
+    if (!pipe->thread) fprintf(stderr, "Error creating simulation thread, simulating on the render thread.\n");
+}
+
+void pipeline_stop(frame_pipeline* pipe) {
+    SDL_AtomicSet(&pipe->running, FALSE);
+    if (pipe->thread) SDL_WaitThread(pipe->thread, NULL);
+    pipe->thread = NULL;
+}
+
+/* Headless Simulation */
+typedef struct headless_job {
+    int id;
+    int frames;
+    world w;
+    Uint64 elapsed;
+    long long rays;
+    ray_stats ray_counts;
+} headless_job;
+
+/* A full screen of rays from the player, the first person view's work without drawing it */
+void cast_frame(world* w) {
+    player* p = &w->player;
+    for (int ray_i = 0; ray_i < WINDOW_WIDTH; ray_i++) {
+#if FIXED_MATH
+        raycast(w, p->fx_x, p->fx_y, fx_wrap_angle((p->fx_angle - (FX_FOV / 2)) + ((FX_FOV * ray_i) / WINDOW_WIDTH)), FALSE);
+#else
+        float ray_angle = (p->angle - (FOV / 2)) + ((FOV / WINDOW_WIDTH) * ray_i);
+        if (ray_angle < 0) ray_angle += M_PI * 2;
+        else if (ray_angle >= M_PI * 2) ray_angle -= M_PI * 2;
+        raycast(w, round(p->x), round(p->y), ray_angle, FALSE);
+#endif
+    }
+}
+
+/* A bot walking and turning through its own world, casting a full screen of rays every frame */
+int headless_thread(void* data) {
+    headless_job* job = data;
+    world* w = &job->w;
+    player* p = &w->player;
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    setup(w, NULL, 0);
+    ray_stats_bind(&job->ray_counts);
+
+    for (int frame = 0; frame < job->frames; frame++) {
+        p->vertical_input = 1;
+        p->rotation_input = ((frame / FPS) + job->id) % 2 ? 1 : -1;
+        update(w, NULL, FRAME_TARGET_TIME);
+        cast_frame(w);
+        job->rays += WINDOW_WIDTH;
+        job->ray_counts.frames++;
+    }
+    ray_stats_bind(NULL);
+
+    job->elapsed = SDL_GetPerformanceCounter() - start;
+    world_free(w);
+    return 0;
+}
+
+/* Runs num_worlds independent worlds side by side, one thread each, with no window */
+int run_headless(int num_worlds, int frames) {
+    headless_job* jobs = calloc(num_worlds, sizeof(*jobs));
+    SDL_Thread** threads = calloc(num_worlds, sizeof(*threads));
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    for (int i = 0; i < num_worlds; i++) {
+        jobs[i].id = i;
+        jobs[i].frames = frames;
+        threads[i] = SDL_CreateThread(headless_thread, "headless world", &jobs[i]);
+        if (!threads[i]) {
+            fprintf(stderr, "Error creating headless thread %d.\n", i);
+            headless_thread(&jobs[i]);
+        }
+    }
+
+    long long total_rays = 0;
+    ray_stats counts = {0};
+    for (int i = 0; i < num_worlds; i++) {
+        if (threads[i]) SDL_WaitThread(threads[i], NULL);
+        total_rays += jobs[i].rays;
+        ray_stats_merge(&counts, &jobs[i].ray_counts);
+        ray_stats_free(&jobs[i].ray_counts);
+    }
+
+    double seconds = (double) (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    printf("%d worlds x %d frames in %f s (%.0f frames/s, %.0f rays/s)\n",
+        num_worlds, frames, seconds, (num_worlds * frames) / seconds, total_rays / seconds);
+#if RAY_STATS
+    printf("%.1f lines tested per ray, %.0f lookups per frame, %.1f%% overshoot\n", counts.rays ? (double) counts.tests / counts.rays : 0,
+        counts.frames ? (double) counts.lookups / counts.frames : 0, counts.tests ? (100.0 * counts.overshoot) / counts.tests : 0);
+#endif
+    ray_stats_free(&counts);
+
+    free(jobs);
+    free(threads);
+    return 0;
+}
+
+/* Verification */
+#define VERIFY_RAYS 2000000
+#define VERIFY_RAY_BATCH 65536
+#define VERIFY_SPOT_TRIES 16
+#define VERIFY_TRACE_EVERY 97 /* Rays also cast through the tracing kernels, which must agree exactly */
+#define VERIFY_FRAME_REPEATS 20
+#define VERIFY_PATH_QUERIES 2000 /* Per round, the map is edited between rounds */
+#define VERIFY_PATH_ROUNDS 3
+#define VERIFY_PERF_TOLERANCE 25 /* Percent slower than the blessed baseline that still passes */
+
+#if FIXED_MATH
+#define VERIFY_SUFFIX "_fx" /* The two math modes render slightly differently, each has its own goldens */
+#else
+#define VERIFY_SUFFIX ""
+#endif
+
+typedef struct verify_pose {
+    const char* name;
+    int map_size; /* 0 for the built in map */
+    float cell_x;
+    float cell_y;
+    int angle_deg;
+    int first_person;
+    int zoom; /* Map view zoom in percent, the camera sits at the map's corner */
+    int split_views; /* 0 for the single first person view */
+    int wall_heights; /* Raise the built in map's demo walls of several heights */
+} verify_pose;
+
+verify_pose verify_poses[] = {
+    {"builtin_spawn", 0, 4, 4, 0, TRUE, 100},
+    {"builtin_room", 0, 5.5f, 9.5f, 225, TRUE, 100},
+    {"builtin_corridor", 0, 13.5f, 13.5f, 270, TRUE, 100},
+    {"builtin_map", 0, 4, 4, 30, FALSE, 60},
+    {"generated_spawn", 64, 4, 4, 45, TRUE, 100},
+    {"generated_map", 64, 4, 4, 45, FALSE, 10},
+    {"large_map_lod1", 256, 4, 4, 45, FALSE, 3}, /* Zoomed out far enough for the LOD blocks */
+    {"large_map_lod2", 256, 4, 4, 45, FALSE, 1},
+    {"builtin_split", 0, 4, 4, 30, TRUE, 100, 4},
+    {"builtin_heights", 0, 2.5f, 9.5f, 350, TRUE, 100, 0, TRUE},
+};
+
+void verify_set_map(world* w, int size) {
+    if (w->grid_enc) world_free(w);
+    setup(w, NULL, size);
+}
+
+void verify_set_pose(world* w, float x, float y, float angle) {
+    player* p = &w->player;
+    p->x = x;
+    p->y = y;
+    p->angle = angle;
+    assign_i_player_pos(p);
+#if FIXED_MATH
+    sync_fx_player(p);
+#endif
+}
+
+/* Whether a player could stand at (x, y), clear of walls by its radius */
+int verify_open_spot(world* w, int x, int y) {
+    int r = w->player.radius;
+    for (int dy = -r; dy <= r; dy += r) {
+        for (int dx = -r; dx <= r; dx += r) {
+            if (get_grid_bool_coords(w, x + dx, y + dy)) return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * A random spot a player could stand on, where rays may start. Spots near a wall are retried a few
+ * times, then one is taken far enough inside its open cell to be clear whatever surrounds it.
+ */
+void verify_random_spot(world* w, Uint32* seed, int* x, int* y) {
+    int r = w->player.radius;
+    xy cell = {0};
+    for (int i = 0; i < VERIFY_SPOT_TRIES; i++) {
+        random_open_cell(w, seed, &cell); /* The verify maps always have open cells */
+        *x = (cell.x * GRID_SPACING) + (next_random(seed) % GRID_SPACING);
+        *y = (cell.y * GRID_SPACING) + (next_random(seed) % GRID_SPACING);
+        if (verify_open_spot(w, *x, *y)) return;
     }
+    *x = (cell.x * GRID_SPACING) + r + (next_random(seed) % (GRID_SPACING - (2 * r)));
+    *y = (cell.y * GRID_SPACING) + r + (next_random(seed) % (GRID_SPACING - (2 * r)));
 }
 
-int main() {
+/*
+ * Casts one ray through raycast_spans. Its first span must land where reference_raycast's hit does,
+ * expected away, and every span must match reference_spans. Returns the first span that doesn't, or -1.
+ */
+#if FIXED_MATH
+int verify_spans(world* w, int x, int y, fixed angle, double dx, double dy, double expected) {
+    wall_span spans[MAX_WALL_SPANS];
+    int num_spans = raycast_spans(w, int_fx(x), int_fx(y), angle, spans);
+#else
+int verify_spans(world* w, int x, int y, float angle, double dx, double dy, double expected) {
+    wall_span spans[MAX_WALL_SPANS];
+    int num_spans = raycast_spans(w, x, y, angle, spans);
+#endif
+    reference_span ref[MAX_WALL_SPANS];
+    int num_ref = reference_spans(w, x, y, dx, dy, ref);
+
+    for (int i = 0; i < SDL_max(num_spans, num_ref); i++) {
+        if (i >= num_spans || i >= num_ref) return i;
+#if FIXED_MATH
+        double hx = fx_flt(spans[i].hit.x), hy = fx_flt(spans[i].hit.y);
+#else
+        double hx = spans[i].hit.x, hy = spans[i].hit.y;
+#endif
+        double got = sqrt(((hx - x) * (hx - x)) + ((hy - y) * (hy - y)));
+        if (
+            fabs(got - ref[i].dist) > VERIFY_RAY_SLACK || (i == 0 && fabs(got - expected) > VERIFY_RAY_SLACK) ||
+            spans[i].height != ref[i].height || spans[i].material != ref[i].material || spans[i].top != ref[i].top
+        ) return i;
+    }
+    return -1;
+}
+
+/*
+ * Casts num_rays random rays from open spots, timing the kernels and checking each hit against reference_raycast,
+ * and the same rays' spans against reference_spans
+ */
+int verify_rays(world* w, int num_rays, double* rays_per_second) {
+    int* xs = malloc(VERIFY_RAY_BATCH * sizeof(*xs));
+    int* ys = malloc(VERIFY_RAY_BATCH * sizeof(*ys));
+    xy* hits = malloc(VERIFY_RAY_BATCH * sizeof(*hits));
+#if FIXED_MATH
+    fixed* angles = malloc(VERIFY_RAY_BATCH * sizeof(*angles));
+    fx_xy* fx_hits = malloc(VERIFY_RAY_BATCH * sizeof(*fx_hits));
+#else
+    float* angles = malloc(VERIFY_RAY_BATCH * sizeof(*angles));
+#endif
+    Uint32 seed = 12345;
+    Uint64 cast_time = 0;
+    int failures = 0;
+
+    for (int done = 0; done < num_rays; done += VERIFY_RAY_BATCH) {
+        int batch = SDL_min(VERIFY_RAY_BATCH, num_rays - done);
+        for (int i = 0; i < batch; i++) {
+            verify_random_spot(w, &seed, &xs[i], &ys[i]);
+#if FIXED_MATH
+            angles[i] = next_random(&seed) % FX_TWO_PI;
+#else
+            angles[i] = (next_random(&seed) % 1000000) * (M_PI * 2 / 1000000);
+#endif
+        }
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < batch; i++) {
+#if FIXED_MATH
+            fx_hits[i] = raycast(w, int_fx(xs[i]), int_fx(ys[i]), angles[i], FALSE);
+#else
+            hits[i] = raycast(w, xs[i], ys[i], angles[i], FALSE);
+#endif
+        }
+        cast_time += SDL_GetPerformanceCounter() - start;
+
+        for (int i = 0; i < batch; i++) {
+#if FIXED_MATH
+            /* Compared in the direction the lookup table gives, its rounding is part of the mode, not an error */
+            double dx = fx_flt(fx_cos(angles[i])), dy = fx_flt(fx_sin(angles[i]));
+            double hx = fx_flt(fx_hits[i].x), hy = fx_flt(fx_hits[i].y);
+            int traced_same = TRUE;
+            if (i % VERIFY_TRACE_EVERY == 0) {
+                fx_xy traced = raycast(w, int_fx(xs[i]), int_fx(ys[i]), angles[i], TRUE);
+                traced_same = traced.x == fx_hits[i].x && traced.y == fx_hits[i].y;
+                clear_temp_dgps(w);
+            }
+#else
+            double dx = cos(angles[i]), dy = sin(angles[i]);
+            double hx = hits[i].x, hy = hits[i].y;
+            int traced_same = TRUE;
+            if (i % VERIFY_TRACE_EVERY == 0) {
+                xy traced = raycast(w, xs[i], ys[i], angles[i], TRUE);
+                traced_same = traced.x == hits[i].x && traced.y == hits[i].y;
+                clear_temp_dgps(w);
+            }
+#endif
+            double expected = reference_raycast(w, xs[i], ys[i], dx, dy);
+            double got = sqrt(((hx - xs[i]) * (hx - xs[i])) + ((hy - ys[i]) * (hy - ys[i])));
+            if (fabs(got - expected) > VERIFY_RAY_SLACK || !traced_same) {
+                if (failures++ < 5) {
+                    printf("  ray from (%d, %d) at %f rad hit (%.1f, %.1f) %.1f away, reference %.1f%s\n", xs[i], ys[i],
+                        atan2(dy, dx), hx, hy, got, expected, traced_same ? "" : ", tracing kernel disagrees");
+                }
+                continue;
+            }
+            int bad_span = verify_spans(w, xs[i], ys[i], angles[i], dx, dy, expected);
+            if (bad_span >= 0 && failures++ < 5) {
+                printf("  ray from (%d, %d) at %f rad: span %d disagrees with the reference spans\n", xs[i], ys[i], atan2(dy, dx), bad_span);
+            }
+        }
+    }
+
+    *rays_per_second = num_rays / ((double) cast_time / SDL_GetPerformanceFrequency());
+    free(xs);
+    free(ys);
+    free(hits);
+    free(angles);
+#if FIXED_MATH
+    free(fx_hits);
+#endif
+    return failures;
+}
+
+/*
+ * Runs random queries through path_batch and compares each cost with reference_path_cost, then edits
+ * the map so later rounds also cover the transposed grid's incremental sync. Returns the queries that
+ * disagree.
+ */
+int verify_paths(world* w) {
+    path_query* queries = malloc(VERIFY_PATH_QUERIES * sizeof(*queries));
+    pathfinder pf;
+    path_pool pool = {0};
+    Uint32 seed = 4242;
+    int failures = 0;
+    pathfinder_init(&pf);
+
+    for (int round = 0; round < VERIFY_PATH_ROUNDS && queries; round++) {
+        for (int i = 0; i < VERIFY_PATH_QUERIES; i++) {
+            xy from = {0}, to = {0};
+            random_open_cell(w, &seed, &from);
+            random_open_cell(w, &seed, &to);
+            queries[i] = (path_query) {from.x, from.y, to.x, to.y, NULL, 0};
+        }
+        path_batch(&pf, w, queries, VERIFY_PATH_QUERIES, SDL_GetCPUCount());
+
+        for (int i = 0; i < VERIFY_PATH_QUERIES; i++) {
+            path_query* q = &queries[i];
+            int expected = reference_path_cost(w, &pool, q->sx, q->sy, q->gx, q->gy);
+            int got = q->num_points == -1 ? -1 : q->cost;
+            if (got == expected) continue;
+            if (failures++ < 5) printf("  path (%d, %d) to (%d, %d) costs %d, reference %d\n", q->sx, q->sy, q->gx, q->gy, got, expected);
+        }
+
+        /* Then a sparse map, whose long open lines cross scan_line's 64 cell windows, then blocks put up and knocked down */
+        if (round == 0) world_fill_cells(w, 1, 1, w->grid_length - 2, w->grid_height - 2, FALSE);
+        for (int e = 0; e < (round == 0 ? (w->grid_length * w->grid_height) / 4096 : 40); e++) {
+            int c[5];
+            for (int k = 0; k < 5; k++) c[k] = next_random(&seed);
+            int x = c[0] % w->grid_length, y = c[1] % w->grid_height;
+            if (round == 0) world_set_cell(w, x, y, TRUE);
+            else world_fill_cells(w, x, y, x + (c[2] % 12), y + (c[3] % 12), c[4] % 3 == 0);
+        }
+    }
+
+    if (!queries) failures++;
+    free(queries);
+    path_pool_free(&pool);
+    pathfinder_free(&pf);
+    return failures;
+}
+
+/*
+ * Checks every LOD level's block counts against the cells they cover, after the first full count and
+ * again once edits have been recounted by region. The camera can't zoom out as far as the top level,
+ * so the golden frames never show it. Returns the blocks that are off.
+ */
+int verify_lod(world* w) {
+    lod_map lod = {0};
+    int bad = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            world_fill_cells(w, 10, 10, 40, 25, TRUE);
+            world_fill_cells(w, 30, 20, 90, 70, FALSE);
+        }
+        lod_sync(&lod, w);
+        for (int l = 1; l < LOD_LEVELS; l++) {
+            int f = lod_factors[l];
+            for (int by = 0; by < lod.blocks_y[l]; by++) {
+                for (int bx = 0; bx < lod.blocks_x[l]; bx++) {
+                    int count = 0;
+                    for (int y = by * f; y < SDL_min((by + 1) * f, w->grid_height); y++) {
+                        for (int x = bx * f; x < SDL_min((bx + 1) * f, w->grid_length); x++) count += get_grid_bool(w, x, y);
+                    }
+                    bad += lod.counts[l][(by * lod.blocks_x[l]) + bx] != count;
+                }
+            }
+        }
+    }
+    lod_free(&lod);
+    return bad;
+}
+
+/* Renders every pose offscreen, diffing against or blessing the goldens, returns the failures */
+int verify_frames(const char* dir, int bless, double* frame_ms) {
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, WINDOW_WIDTH, WINDOW_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer* offscreen = surface ? SDL_CreateSoftwareRenderer(surface) : NULL;
+    int num_pixels = WINDOW_WIDTH * WINDOW_HEIGHT;
+    Uint8* pixels = malloc(num_pixels * 3);
+    Uint8* golden = malloc(num_pixels * 3);
+    Uint64 render_time = 0;
+    int renders = 0;
+    int failures = 0;
+    world w = {0};
+    camera cam = {0};
+    render_ctx rc;
+
+    if (!offscreen) {
+        printf("FAIL frames: no offscreen renderer (%s)\n", SDL_GetError());
+        free(pixels);
+        free(golden);
+        return 1;
+    }
+
+    for (int i = 0; i < (int) (sizeof(verify_poses) / sizeof(verify_poses[0])); i++) {
+        verify_pose* pose = &verify_poses[i];
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s%s.ppm", dir, pose->name, VERIFY_SUFFIX);
+
+        verify_set_map(&w, pose->map_size);
+        if (pose->wall_heights) raise_demo_walls(&w);
+        verify_set_pose(&w, pose->cell_x * GRID_SPACING, pose->cell_y * GRID_SPACING, pose->angle_deg * (M_PI / 180));
+        reset_grid_cam(&cam);
+        cam.zoom = pose->zoom;
+        calc_grid_cam_zoom_p(&cam);
+        render_ctx_init(&rc, offscreen);
+        rc.render_in_first_person = pose->first_person;
+        rc.split_views = SDL_max(pose->split_views, 1);
+        add_default_lights(&rc.lighting);
+
+        for (int r = 0; r < VERIFY_FRAME_REPEATS; r++) {
+            rc.columns.valid = FALSE; /* Time the full cast, not the reused columns */
+            Uint64 start = SDL_GetPerformanceCounter();
+            render(&w, &cam, &rc);
+            render_time += SDL_GetPerformanceCounter() - start;
+            renders++;
+        }
+        SDL_RenderReadPixels(offscreen, NULL, SDL_PIXELFORMAT_RGB24, pixels, WINDOW_WIDTH * 3);
+        render_ctx_free(&rc);
+
+        if (bless) {
+            if (write_ppm(path, pixels, WINDOW_WIDTH, WINDOW_HEIGHT)) printf("blessed %s\n", path);
+            else {
+                printf("FAIL %s: can't write it\n", path);
+                failures++;
+            }
+            continue;
+        }
+        if (!read_ppm(path, golden, WINDOW_WIDTH, WINDOW_HEIGHT)) {
+            printf("FAIL %s: no golden frame, run --verify %s --bless first\n", path, dir);
+            failures++;
+            continue;
+        }
+        int bad = compare_frames(pixels, golden, golden, num_pixels);
+        if ((long long) bad * 1000000 > (long long) VERIFY_BAD_PIXELS_PER_MILLION * num_pixels) {
+            snprintf(path, sizeof(path), "%s/%s%s.diff.ppm", dir, pose->name, VERIFY_SUFFIX);
+            write_ppm(path, golden, WINDOW_WIDTH, WINDOW_HEIGHT);
+            printf("FAIL %s: %d pixels differ, see %s\n", pose->name, bad, path);
+            failures++;
+        } else printf("ok   %s (%d pixels differ, within tolerance)\n", pose->name, bad);
+    }
+
+    *frame_ms = render_time / (SDL_GetPerformanceFrequency() / 1000.0) / renders;
+    world_free(&w);
+    SDL_DestroyRenderer(offscreen);
+    SDL_FreeSurface(surface);
+    free(pixels);
+    free(golden);
+    return failures;
+}
+
+/*
+ * Golden frame, reference raycaster and performance checks, for proving an optimization changed
+ * nothing but speed. --bless records the current frames and speed as the new baseline. Checks with
+ * no baseline to compare against fail, so an unblessed directory never reports a pass.
+ */
+int run_verify(const char* dir, int bless, int num_rays) {
+    world w = {0};
+    double rays_per_second, frame_ms;
+    int failures = 0;
+    char path[512];
+
+    /* The built in map, then with a wall layer for the spans, then a large generated one, timed last for the baseline */
+    for (int map = 0; map < 3; map++) {
+        verify_set_map(&w, map == 2 ? 256 : 0);
+        if (map == 1) raise_demo_walls(&w);
+        const char* layer = map == 1 ? " layered" : "";
+        int bad = verify_rays(&w, num_rays, &rays_per_second);
+        if (bad) printf("FAIL rays on the %dx%d%s map: %d of %d disagree with the reference\n", w.grid_length, w.grid_height, layer, bad, num_rays);
+        else printf("ok   %d rays on the %dx%d%s map match the reference, %.0f rays/s\n", num_rays, w.grid_length, w.grid_height, layer, rays_per_second);
+        failures += bad != 0;
+    }
+    int bad_blocks = verify_lod(&w); /* On the large map, edited */
+    if (bad_blocks) printf("FAIL LOD counts: %d blocks disagree with their cells\n", bad_blocks);
+    else printf("ok   LOD counts match the cells at every level\n");
+    failures += bad_blocks != 0;
+    for (int size = 0; size <= 256; size += 256) {
+        verify_set_map(&w, size);
+        int bad = verify_paths(&w);
+        if (bad) printf("FAIL paths on the %dx%d map: %d disagree with plain A*\n", w.grid_length, w.grid_height, bad);
+        else printf("ok   %d paths on the %dx%d map, edited between rounds, cost the same as plain A*\n", VERIFY_PATH_QUERIES * VERIFY_PATH_ROUNDS, w.grid_length, w.grid_height);
+        failures += bad != 0;
+    }
+    world_free(&w);
+
+    failures += verify_frames(dir, bless, &frame_ms);
+    printf("     %.3f ms per frame\n", frame_ms);
+
+    /* Speed against the blessed baseline, only meaningful on the machine that blessed it */
+    snprintf(path, sizeof(path), "%s/perf%s.txt", dir, VERIFY_SUFFIX);
+    FILE* f = fopen(path, bless ? "w" : "r");
+    double base_rays, base_ms;
+    if (!f && bless) {
+        printf("FAIL %s: can't write it\n", path);
+        failures++;
+    } else if (!f) {
+        printf("FAIL %s: no baseline, run --verify %s --bless first\n", path, dir);
+        failures++;
+    } else if (bless) {
+        fprintf(f, "rays_per_second %f\nframe_ms %f\n", rays_per_second, frame_ms);
+        printf("blessed %s\n", path);
+    } else if (fscanf(f, "rays_per_second %lf frame_ms %lf", &base_rays, &base_ms) == 2) {
+        if (rays_per_second < base_rays * (100 - VERIFY_PERF_TOLERANCE) / 100) {
+            printf("FAIL rays/s regressed: %.0f, baseline %.0f\n", rays_per_second, base_rays);
+            failures++;
+        }
+        if (frame_ms > base_ms * (100 + VERIFY_PERF_TOLERANCE) / 100) {
+            printf("FAIL frame time regressed: %.3f ms, baseline %.3f ms\n", frame_ms, base_ms);
+            failures++;
+        }
+    } else {
+        printf("FAIL %s: unreadable baseline\n", path);
+        failures++;
+    }
+    if (f) fclose(f);
+
+    printf(failures ? "verify FAILED, %d checks\n" : "verify passed\n", failures);
+    return failures != 0;
+}
+
+/* Replay */
+
+/* Feeds recorded events to the simulation up to and including the next tick, FALSE once the recording ends */
+int replay_step(replay_file* rf, frame_pipeline* pipe, camera* cam) {
+    replay_event e;
+    while (replay_read(rf, &e)) {
+        if (e.tag == REPLAY_COMMAND) {
+            console_command cmd = {"", CONSOLE_OVERLAY};
+            strcpy(cmd.line, e.line);
+            run_console_command(&cmd);
+        } else if (e.tag == REPLAY_VIEW) {
+            cam->x = e.view.x;
+            cam->y = e.view.y;
+            cam->zoom = e.view.zoom;
+            cam->follow_player = e.view.follow_player;
+            calc_grid_cam_zoom_p(cam);
+            game_render.render_in_first_person = e.view.first_person;
+        } else if (e.tag == REPLAY_CHECK) {
+            replay_verify(rf, e.hash, world_hash(pipe->w, FALSE));
+        } else if (e.tag == REPLAY_END) {
+            replay_verify(rf, e.hash, world_hash(pipe->w, TRUE));
+            return FALSE;
+        } else {
+            pipe->controls = e.controls;
+            sim_tick(pipe, e.delta_ticks);
+            rf->ticks++;
+            return TRUE;
+        }
+    }
+    fprintf(stderr, "Replay ended without its end record, it was cut short.\n");
+    return FALSE;
+}
+
+void replay_report(replay_file* rf, Uint64 elapsed) {
+    double seconds = (double) elapsed / SDL_GetPerformanceFrequency();
+    printf("replayed %d ticks in %f s (%.0f ticks/s), render %.3f ms/frame\n", rf->ticks, seconds, rf->ticks / seconds,
+        game_profile.frames ? game_profile.render_time / (SDL_GetPerformanceFrequency() / 1000.0) / game_profile.frames : 0.0);
+    if (rf->diverged_tick != -1) printf("replay DIVERGED from the recording by tick %d\n", rf->diverged_tick);
+    else printf("replay matches the recording, %d checks\n", rf->checks);
+}
+
+int main(int argc, char* argv[]) {
     printf("Start\n");
 
-    game_is_running = initialize_window();
+    bit_rep_init();
+    fx_trig_init();
+
+    if (argc >= 3 && strcmp(argv[1], "--headless") == 0) {
+        return run_headless(atoi(argv[2]), argc >= 4 ? atoi(argv[3]) : FPS * 10);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--verify") == 0) { /* --verify [DIR] [--bless] [--rays N] */
+        const char* dir = "verify";
+        int bless = FALSE;
+        int num_rays = VERIFY_RAYS;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--bless") == 0) bless = TRUE;
+            else if (strcmp(argv[i], "--rays") == 0 && i + 1 < argc) num_rays = max(atoi(argv[++i]), 1);
+            else dir = argv[i];
+        }
+        return run_verify(dir, bless, num_rays);
+    }
+    if (argc >= 4 && strcmp(argv[1], "--unpack") == 0) { /* --unpack STREAM DIR, a capture stream to PPMs */
+        int frames = capture_unpack(argv[2], argv[3]);
+        if (frames < 0) fprintf(stderr, "Error unpacking %s into %s.\n", argv[2], argv[3]);
+        else printf("unpacked %d frames into %s\n", frames, argv[3]);
+        return frames < 0;
+    }
+    int serial = FALSE;
+    int windowed = TRUE;
+    int map_size = 0; /* Side of a generated map in cells, 0 for the built in one */
+    const char* record_path = NULL;
+    const char* replay_path = NULL;
+    const char* capture_path = NULL;
+    char console_path[108];
+    console_default_path(console_path, sizeof(console_path));
+    int pace_mode = PACE_FIXED;
+    double pace_hz = FPS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--serial") == 0) serial = TRUE; /* Simulate and render on one thread */
+        else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) map_size = max(atoi(argv[++i]), 8);
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) record_path = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) replay_path = argv[++i];
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) capture_path = argv[++i];
+        else if (strcmp(argv[i], "--console") == 0 && i + 1 < argc) snprintf(console_path, sizeof(console_path), "%s", argv[++i]);
+        else if (strcmp(argv[i], "--pace") == 0 && i + 1 < argc) { /* uncapped, fixed, vsync or adaptive */
+            int mode = pace_mode_from_name(argv[++i]);
+            if (mode >= 0) pace_mode = mode;
+            else fprintf(stderr, "Unknown pacing %s, pacing fixed.\n", argv[i]);
+        }
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) pace_hz = SDL_max(atof(argv[++i]), 1);
+        else if (strcmp(argv[i], "--no-window") == 0) windowed = FALSE; /* Replays cast each frame's rays without drawing */
+    }
+
+    /* A replay brings its own map size, and runs serially at full speed */
+    if (replay_path) {
+        if (!replay_open(&game_replay, replay_path, &map_size)) return 1;
+        serial = TRUE;
+        record_path = NULL;
+    } else windowed = TRUE;
+
+    game_is_running = windowed ? initialize_window(pace_mode == PACE_VSYNC) : TRUE;
+    pacer_init(&game_pacer, pace_mode, pace_hz, display_refresh_hz());
+
+    if (windowed) input_init(&input);
+    setup(&game_world, &game_camera, map_size);
+    game_world.log = !replay_path;
+    if (record_path && !replay_record(&game_record, record_path, map_size)) fprintf(stderr, "Error creating recording %s.\n", record_path);
+    world_init(&view_world, game_world.grid_length, game_world.grid_height);
+    world_copy_grid(&view_world, &game_world);
+    view_world.player = game_world.player;
+    pipeline_init(&game_pipe, &game_world);
+    render_ctx_init(&game_render, renderer);
+    game_render.con = &game_console;
+    game_render.capture = &game_capture;
+    add_default_lights(&game_render.lighting);
+    lightmap_sync(&game_render.lighting, &view_world); /* Bake at load rather than on the first frame */
+    setup_console_vars();
+    pathfinder_init(&game_paths);
+    console_init(&game_console, CONSOLE_SOCKET && !replay_path ? console_path : NULL);
+#if CONSOLE_SOCKET
+    if (game_console.listen_fd != -1) printf("console socket %s\n", game_console.socket_path);
+#endif
+
+    if (capture_path && windowed && !capture_start(&game_capture, capture_path, WINDOW_WIDTH, WINDOW_HEIGHT)) {
+        fprintf(stderr, "Error capturing to %s.\n", capture_path);
+    }
 
-    setup();
+    if (!serial) pipeline_start(&game_pipe);
+    Uint64 replay_start = SDL_GetPerformanceCounter();
 
     while (game_is_running) {
-        process_input();
-        update();
-        render();
+        if (game_replay.f) { /* Live input can only end a replay */
+            if (windowed) {
+                input_poll(&input);
+                if (input.quit || input.keys[SDL_SCANCODE_ESCAPE]) game_is_running = FALSE;
+            }
+            SDL_LockMutex(game_pipe.sim_lock);
+            if (!replay_step(&game_replay, &game_pipe, &game_camera)) game_is_running = FALSE;
+            SDL_UnlockMutex(game_pipe.sim_lock);
+        } else {
+            wait_for_frame(); /* Sleep before sampling input so it is as fresh as possible for the update */
+            console_poll(&game_console);
+            process_input(&game_pipe, &game_camera);
+
+            /* Frame boundary, the simulation is between ticks while the lock is held */
+            SDL_LockMutex(game_pipe.sim_lock);
+            if (game_record.f) {
+                replay_record_view(&game_record, (replay_view) {
+                    game_camera.x, game_camera.y, game_camera.zoom, game_camera.follow_player, game_render.render_in_first_person
+                });
+            }
+            run_console_commands(&game_console);
+            if (game_pipe.paused ? game_pipe.steps > 0 : !game_pipe.thread) {
+                sim_tick(&game_pipe, game_pipe.paused ? FRAME_TARGET_TIME : last_frame_ticks);
+                if (game_pipe.paused) game_pipe.steps--;
+            }
+            SDL_UnlockMutex(game_pipe.sim_lock);
+            game_profile.input_delay += input_queue_delay(&input);
+        }
+
+        frame_snapshot* snap = pipeline_acquire(&game_pipe);
+        if (snap) snapshot_apply(snap, &view_world, &game_pipe);
+        if (game_camera.follow_player) camera_follow(&game_camera, &view_world.player);
+        Uint64 render_start = SDL_GetPerformanceCounter();
+        if (windowed) render(&view_world, &game_camera, &game_render);
+        else cast_frame(&view_world);
+        game_profile.render_time += SDL_GetPerformanceCounter() - render_start;
+        game_profile.frames++;
     }
 
+    pipeline_stop(&game_pipe);
+    if (game_capture.thread) {
+        capture_stop(&game_capture);
+        printf("captured %d frames to %s, %d written, %d dropped, %.2f MB\n", game_capture.frames, game_capture.path,
+            game_capture.written, game_capture.dropped, game_capture.bytes / (1024.0 * 1024.0));
+    }
+    if (game_record.f) replay_finish(&game_record, world_hash(&game_world, TRUE));
+    int diverged = FALSE;
+    if (game_replay.f) {
+        replay_report(&game_replay, SDL_GetPerformanceCounter() - replay_start);
+        diverged = game_replay.diverged_tick != -1;
+        fclose(game_replay.f);
+    }
+    pipeline_free(&game_pipe);
+    console_free(&game_console);
+    render_ctx_free(&game_render);
     free_memory();
-    destroy_window();
+    if (windowed) destroy_window();
 
-    return 0;
-}
\ No newline at end of file
+    return diverged;
+}
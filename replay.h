@@ -0,0 +1,210 @@
+/* Input Recording And Replay */
+
+/*
+ * A recording holds everything that reaches the simulation, in the order it happened under sim_lock:
+ * each tick's controls and delta, console commands, and view changes for the render side. Feeding it
+ * back through sim_tick rebuilds the world bit for bit, which hashes written between ticks confirm.
+ * Records are a tag byte and varints, a tick at 60 FPS costs two bytes.
+ */
+#define REPLAY_MAGIC "RRIN"
+#define REPLAY_VERSION 1
+#define REPLAY_CHECK_INTERVAL 60 /* Ticks between state hashes */
+
+/* Tags, a clear top bit is a tick with its controls packed into the low bits */
+#define REPLAY_TICK_RESET 0x40
+#define REPLAY_COMMAND 0x80
+#define REPLAY_VIEW 0x81
+#define REPLAY_CHECK 0x82
+#define REPLAY_END 0x83
+
+typedef struct replay_view {
+    int x;
+    int y;
+    int zoom;
+    int follow_player;
+    int first_person;
+} replay_view;
+
+typedef struct replay_file {
+    FILE* f;
+    int ticks;
+    replay_view last_view; /* Recording only writes views that changed */
+    int checks;
+    int diverged_tick; /* Tick of the first failed check, -1 while all matched */
+} replay_file;
+
+typedef struct replay_event {
+    int tag;
+    player_controls controls;
+    int delta_ticks;
+    char line[CONSOLE_LINE_LEN];
+    replay_view view;
+    Uint32 hash;
+} replay_event;
+
+/* Encoding */
+void replay_put_varint(FILE* f, Uint32 v) {
+    while (v >= 0x80) {
+        fputc((v & 0x7F) | 0x80, f);
+        v >>= 7;
+    }
+    fputc(v, f);
+}
+
+int replay_get_varint(FILE* f, Uint32* v) {
+    *v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int c = fgetc(f);
+        if (c == EOF) return FALSE;
+        *v |= (Uint32) (c & 0x7F) << shift;
+        if (!(c & 0x80)) return TRUE;
+    }
+    return FALSE;
+}
+
+/* Signed values interleaved so small negatives stay one byte */
+Uint32 zigzag(int v) {
+    return ((Uint32) v << 1) ^ (Uint32) (v >> 31);
+}
+
+int unzigzag(Uint32 v) {
+    return (int) (v >> 1) ^ -(int) (v & 1);
+}
+
+/* FNV-1a over the authoritative player state, and the grid for the final check */
+Uint32 hash_bytes(Uint32 h, const void* data, size_t len) {
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < len; i++) h = (h ^ bytes[i]) * 16777619u;
+    return h;
+}
+
+Uint32 world_hash(world* w, int with_grid) {
+    player* p = &w->player;
+    Uint32 h = 2166136261u;
+#if FIXED_MATH
+    fixed state[] = {p->fx_x, p->fx_y, p->fx_x_velocity, p->fx_y_velocity, p->fx_angle};
+#else
+    float state[] = {p->x, p->y, p->x_velocity, p->y_velocity, p->angle};
+#endif
+    h = hash_bytes(h, state, sizeof(state));
+    if (with_grid) h = hash_bytes(h, w->grid_enc, grid_enc_size(w->grid_length, w->grid_height));
+    if (with_grid && w->wall_layer) h = hash_bytes(h, w->wall_layer, w->grid_length * w->grid_height);
+    return h;
+}
+
+/* Recording */
+int replay_record(replay_file* rf, const char* path, int map_size) {
+    memset(rf, 0, sizeof(*rf));
+    rf->f = fopen(path, "wb");
+    if (!rf->f) return FALSE;
+    rf->last_view.zoom = -1; /* Forces the first view out */
+    fwrite(REPLAY_MAGIC, 1, 4, rf->f);
+    fputc(REPLAY_VERSION, rf->f);
+    fputc(FIXED_MATH, rf->f);
+    replay_put_varint(rf->f, map_size);
+    return TRUE;
+}
+
+void replay_record_tick(replay_file* rf, player_controls c, int delta_ticks) {
+    int tag = (c.horizontal + 1) | ((c.vertical + 1) << 2) | ((c.rotation + 1) << 4) | (c.reset ? REPLAY_TICK_RESET : 0);
+    fputc(tag, rf->f);
+    replay_put_varint(rf->f, delta_ticks);
+    rf->ticks++;
+}
+
+void replay_record_command(replay_file* rf, const char* line) {
+    int len = strlen(line);
+    fputc(REPLAY_COMMAND, rf->f);
+    replay_put_varint(rf->f, len);
+    fwrite(line, 1, len, rf->f);
+}
+
+void replay_record_view(replay_file* rf, replay_view view) {
+    if (view.follow_player) { /* The replay follows the player by itself, leave out the position moving every frame */
+        view.x = 0;
+        view.y = 0;
+    }
+    if (memcmp(&view, &rf->last_view, sizeof(view)) == 0) return;
+    rf->last_view = view;
+    fputc(REPLAY_VIEW, rf->f);
+    replay_put_varint(rf->f, zigzag(view.x));
+    replay_put_varint(rf->f, zigzag(view.y));
+    replay_put_varint(rf->f, view.zoom);
+    fputc((view.follow_player ? 1 : 0) | (view.first_person ? 2 : 0), rf->f);
+}
+
+void replay_record_check(replay_file* rf, int tag, Uint32 hash) {
+    hash = SDL_SwapLE32(hash);
+    fputc(tag, rf->f);
+    fwrite(&hash, sizeof(hash), 1, rf->f);
+}
+
+void replay_finish(replay_file* rf, Uint32 hash) {
+    replay_record_check(rf, REPLAY_END, hash);
+    fclose(rf->f);
+    rf->f = NULL;
+}
+
+/* Replay */
+int replay_open(replay_file* rf, const char* path, int* map_size) {
+    char magic[4];
+    Uint32 size;
+    memset(rf, 0, sizeof(*rf));
+    rf->diverged_tick = -1;
+    rf->f = fopen(path, "rb");
+    if (!rf->f) {
+        fprintf(stderr, "Error opening replay %s.\n", path);
+        return FALSE;
+    }
+    if (fread(magic, 1, 4, rf->f) != 4 || memcmp(magic, REPLAY_MAGIC, 4) != 0 || fgetc(rf->f) != REPLAY_VERSION) {
+        fprintf(stderr, "%s is not a replay this build can read.\n", path);
+    } else if (fgetc(rf->f) != FIXED_MATH) {
+        fprintf(stderr, "%s was recorded with FIXED_MATH %s, it would not replay the same.\n", path, FIXED_MATH ? "off" : "on");
+    } else if (replay_get_varint(rf->f, &size)) {
+        *map_size = size;
+        return TRUE;
+    }
+    fclose(rf->f);
+    rf->f = NULL;
+    return FALSE;
+}
+
+/* Reads the next record, FALSE at the end of the file or on a damaged one */
+int replay_read(replay_file* rf, replay_event* e) {
+    Uint32 v[3];
+    int c = fgetc(rf->f);
+    if (c == EOF) return FALSE;
+    e->tag = c;
+
+    if (!(c & REPLAY_COMMAND)) {
+        e->controls.horizontal = (c & 3) - 1;
+        e->controls.vertical = ((c >> 2) & 3) - 1;
+        e->controls.rotation = ((c >> 4) & 3) - 1;
+        e->controls.reset = (c & REPLAY_TICK_RESET) != 0;
+        if (!replay_get_varint(rf->f, &v[0])) return FALSE;
+        e->delta_ticks = v[0];
+        return TRUE;
+    }
+    switch (c) {
+        case REPLAY_COMMAND:
+            if (!replay_get_varint(rf->f, &v[0]) || v[0] >= CONSOLE_LINE_LEN || fread(e->line, 1, v[0], rf->f) != v[0]) return FALSE;
+            e->line[v[0]] = '\0';
+            return TRUE;
+        case REPLAY_VIEW:
+            if (!replay_get_varint(rf->f, &v[0]) || !replay_get_varint(rf->f, &v[1]) || !replay_get_varint(rf->f, &v[2])) return FALSE;
+            if ((c = fgetc(rf->f)) == EOF) return FALSE;
+            e->view = (replay_view) {unzigzag(v[0]), unzigzag(v[1]), v[2], c & 1, (c & 2) != 0};
+            return TRUE;
+        case REPLAY_CHECK:
+        case REPLAY_END:
+            if (fread(&e->hash, sizeof(e->hash), 1, rf->f) != 1) return FALSE;
+            e->hash = SDL_SwapLE32(e->hash);
+            return TRUE;
+    }
+    return FALSE;
+}
+
+void replay_verify(replay_file* rf, Uint32 recorded, Uint32 replayed) {
+    rf->checks++;
+    if (recorded != replayed && rf->diverged_tick == -1) rf->diverged_tick = rf->ticks;
+}
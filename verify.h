@@ -0,0 +1,155 @@
+/* Verification */
+
+/*
+ * Pieces of the --verify mode. A reference raycaster that walks the grid cell by cell in double
+ * precision and a plain A* search, for the optimized kernels and the jump point search to be compared
+ * against, and golden frames kept as binary PPM files, compared pixel by pixel with a per channel tolerance.
+ */
+#define VERIFY_CHANNEL_TOLERANCE 8 /* Per channel difference still counted as the same pixel */
+#define VERIFY_BAD_PIXELS_PER_MILLION 2000 /* Differing pixels a frame may have and still pass */
+#define VERIFY_RAY_SLACK 2.0 /* Pixels a kernel hit may be off from the reference, the float kernels return whole pixels */
+
+/*
+ * Distance along the direction (dx, dy) from (x, y) to the first solid cell, or to the edge of the
+ * cells the kernels step through. The next line is picked by comparing cross products rather than
+ * accumulated distances, exact for the fixed math directions, so a ray through a grid corner always
+ * crosses the horizontal line first.
+ */
+double reference_raycast(world* w, double x, double y, double dx, double dy) {
+    int cx = floor(x / GRID_SPACING);
+    int cy = floor(y / GRID_SPACING);
+    int step_x = dx > 0 ? 1 : -1;
+    int step_y = dy > 0 ? 1 : -1;
+
+    while (TRUE) {
+        double to_x = ((cx + (dx > 0)) * GRID_SPACING) - x; /* Along each axis to the next line */
+        double to_y = ((cy + (dy > 0)) * GRID_SPACING) - y;
+        double t;
+        if (dy == 0 || (dx != 0 && fabs(to_x * dy) < fabs(to_y * dx))) {
+            t = to_x / dx;
+            cx += step_x;
+        } else {
+            t = to_y / dy;
+            cy += step_y;
+        }
+        if (cx <= 0 || cy <= 0 || cx >= w->grid_length - 1 || cy >= w->grid_height - 1 || get_grid_bool(w, cx, cy)) return t * sqrt((dx * dx) + (dy * dy));
+    }
+}
+
+typedef struct reference_span {
+    double dist;
+    int height;
+    int material;
+    int top;
+} reference_span;
+
+/*
+ * The spans raycast_spans should list for the same ray, walked like reference_raycast. The stepping is
+ * the reference's own, the rules for which walls give spans and where the walk stops follow heights.h.
+ */
+int reference_spans(world* w, double x, double y, double dx, double dy, reference_span* spans) {
+    int cx = floor(x / GRID_SPACING);
+    int cy = floor(y / GRID_SPACING);
+    int step_x = dx > 0 ? 1 : -1;
+    int step_y = dy > 0 ? 1 : -1;
+    int num_spans = 0, run = -1;
+
+    while (TRUE) {
+        double to_x = ((cx + (dx > 0)) * GRID_SPACING) - x;
+        double to_y = ((cy + (dy > 0)) * GRID_SPACING) - y;
+        double t;
+        if (dy == 0 || (dx != 0 && fabs(to_x * dy) < fabs(to_y * dx))) {
+            t = to_x / dx;
+            cx += step_x;
+        } else {
+            t = to_y / dy;
+            cy += step_y;
+        }
+        double dist = t * sqrt((dx * dx) + (dy * dy));
+        int on_map = in_grid(w, cx, cy);
+        int cell = !on_map ? 0 : get_grid_bool(w, cx, cy) ? get_wall_info(w, cx, cy) : -1;
+        if (cell == run) {
+            if (!on_map) return num_spans;
+            continue;
+        }
+        int run_height = (run & 15) ? run & 15 : WALL_HEIGHT_FULL;
+        if (run >= 0 && run_height * 2 < WALL_HEIGHT_FULL) spans[num_spans++] = (reference_span) {dist, run_height, run >> 4, TRUE};
+        run = cell;
+        if (cell < 0) continue;
+        int height = (cell & 15) ? cell & 15 : WALL_HEIGHT_FULL;
+        spans[num_spans++] = (reference_span) {dist, height, cell >> 4, FALSE};
+        if (!on_map || (height >= w->tallest_wall && height * 2 >= WALL_HEIGHT_FULL) || num_spans >= MAX_WALL_SPANS - 1) return num_spans;
+    }
+}
+
+/*
+ * Cost of the cheapest path from (sx, sy) to (gx, gy) by plain A* over all 8 neighbours of every cell,
+ * with the same costs and no corner cutting, for path_find's jumps to be compared against. -1 when
+ * there is no path, -2 when the pool can't be allocated.
+ */
+int reference_path_cost(world* w, path_pool* pool, int sx, int sy, int gx, int gy) {
+    int len = w->grid_length;
+    if (!path_walkable(w, sx, sy) || !path_walkable(w, gx, gy)) return -1;
+    if (!path_pool_begin(pool, len * w->grid_height)) return -2;
+    int start = (sy * len) + sx;
+    int goal = (gy * len) + gx;
+    pool->seen[start] = pool->query;
+    pool->g[start] = 0;
+    if (!path_heap_push(pool, (path_heap_entry) {octile(sx, sy, gx, gy), 0, start})) return -2;
+
+    while (pool->heap_len) {
+        path_heap_entry e = path_heap_pop(pool);
+        if (pool->closed[e.cell] == pool->query || e.g != pool->g[e.cell]) continue;
+        pool->closed[e.cell] = pool->query;
+        if (e.cell == goal) return e.g;
+
+        int x = e.cell % len, y = e.cell / len;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                if ((!dx && !dy) || !path_walkable(w, x + dx, y + dy)) continue;
+                if (dx && dy && !(path_walkable(w, x + dx, y) && path_walkable(w, x, y + dy))) continue;
+                int cell = e.cell + (dy * len) + dx;
+                int g = e.g + (dx && dy ? PATH_DIAGONAL_COST : PATH_STRAIGHT_COST);
+                if (pool->seen[cell] == pool->query && g >= pool->g[cell]) continue;
+                pool->seen[cell] = pool->query;
+                pool->g[cell] = g;
+                if (!path_heap_push(pool, (path_heap_entry) {g + octile(x + dx, y + dy, gx, gy), g, cell})) return -2;
+            }
+        }
+    }
+    return -1;
+}
+
+/* Golden Frames */
+int write_ppm(const char* path, const Uint8* rgb_pixels, int width, int height) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return FALSE;
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    int ok = fwrite(rgb_pixels, 3, width * height, f) == (size_t) (width * height);
+    fclose(f);
+    return ok;
+}
+
+/* Reads a PPM written by write_ppm into pixels, which must hold width * height RGB pixels */
+int read_ppm(const char* path, Uint8* rgb_pixels, int width, int height) {
+    int w, h, maxval;
+    FILE* f = fopen(path, "rb");
+    if (!f) return FALSE;
+    int ok = fscanf(f, "P6 %d %d %d", &w, &h, &maxval) == 3 && fgetc(f) != EOF &&
+        w == width && h == height && maxval == 255 &&
+        fread(rgb_pixels, 3, width * height, f) == (size_t) (width * height);
+    fclose(f);
+    return ok;
+}
+
+/* Pixels differing by more than the channel tolerance, marked white in diff (black elsewhere) when given */
+int compare_frames(const Uint8* a, const Uint8* b, Uint8* diff, int num_pixels) {
+    int bad = 0;
+    for (int i = 0; i < num_pixels; i++) {
+        int differs = FALSE;
+        for (int c = 0; c < 3; c++) differs |= abs(a[(i * 3) + c] - b[(i * 3) + c]) > VERIFY_CHANNEL_TOLERANCE;
+        bad += differs;
+        if (diff) memset(&diff[i * 3], differs ? 255 : 0, 3);
+    }
+    return bad;
+}
@@ -0,0 +1,638 @@
+/* World, Player and Camera Contexts */
+
+typedef struct xy {
+    int x;
+    int y;
+} xy;
+
+struct debug_grid_point {
+    int x;
+    int y;
+    rgb color;
+    struct debug_grid_point* next;
+};
+
+/* Player */
+typedef struct player {
+    float x;
+    int i_x;
+    float y;
+    int i_y;
+    int radius;
+    float x_velocity;
+    float y_velocity;
+    float velocity_angle;
+    int max_velocity;
+    float angle;
+    int movement_accel;
+    int movement_decel;
+    float angle_increment;
+    int rotation_speed;
+#if FIXED_MATH
+    /* Authoritative state in fixed math mode, the float fields above mirror it */
+    fixed fx_x;
+    fixed fx_y;
+    fixed fx_x_velocity;
+    fixed fx_y_velocity;
+    fixed fx_angle;
+    fixed fx_angle_increment;
+#endif
+    /* Control input for the next update, -1, 0 or 1 per key held */
+    char horizontal_input;
+    char vertical_input;
+    char rotation_input;
+} player;
+
+const float FOV = M_PI / 3;
+#if FIXED_MATH
+const fixed FX_FOV = FX_PI / 3;
+
+#define PLAYER_X_MOVING(p) ((p)->fx_x_velocity != 0)
+#else
+#define PLAYER_X_MOVING(p) ((p)->x_velocity != 0)
+#endif
+
+/* World */
+#define MAX_CHANGED_CELLS 256
+
+typedef struct grid_cell_change {
+    int x;
+    int y;
+    int val;
+    Uint8 wall; /* The cell's wall layer byte, 0 on flat maps */
+} grid_cell_change;
+
+/*
+ * Optional wall layer, one byte per cell beside grid_enc: the low nibble is the wall's height in
+ * eighths of a full wall, 0 meaning full so a zeroed layer is the flat map, and the high nibble its
+ * material. Only solid cells use it. Maps that never set a wall keep no layer at all.
+ */
+#define WALL_HEIGHT_FULL 8
+#define WALL_HEIGHT_MAX 15
+#define WALL_MATERIALS 16
+#define wall_info(height, material) ((Uint8) ((((material) & 15) << 4) | ((height) == WALL_HEIGHT_FULL ? 0 : (height) & 15)))
+
+typedef struct world {
+    /* Physical Grid */
+    int grid_length;
+    int grid_height;
+    bool_cont* grid_enc;
+    Uint8* wall_layer; /* NULL while every wall is full height and plain */
+    int tallest_wall; /* In eighths, never lowered, so rays know when nothing behind a wall can show */
+    /* Cells written since the last snapshot took them, see pipeline.h */
+    int num_changed_cells;
+    int changed_cells_overflow;
+    grid_cell_change changed_cells[MAX_CHANGED_CELLS];
+    dirty_tracker dirty; /* Regions changed since the map loaded, for everything cached from the grid */
+    player player;
+    int show_player_trail;
+    int log; /* Print physics and collision info every update */
+    /* Debug Points */
+    int num_fill_dgps;
+    int max_fill_dgps;
+    struct debug_grid_point* fill_dgp_head;
+    struct debug_grid_point* fill_dgp_tail;
+    struct debug_grid_point* temp_dgp_head;
+    struct debug_grid_point* temp_dgp_tail;
+} world;
+
+/* Grid Visual Camera */
+typedef struct camera {
+    int x;
+    int y;
+    int zoom;
+    float zoom_p;
+    int zoom_min;
+    int zoom_max;
+    int center_x;
+    int center_y;
+    int follow_player;
+} camera;
+
+/* Bytes in a packed grid of this size */
+size_t grid_enc_size(int grid_length, int grid_height) {
+    return (((grid_length * grid_height) + BOOL_CONT_BITS - 1) / BOOL_CONT_BITS) * SIZE_BOOL_CONT;
+}
+
+void world_init(world* w, int grid_length, int grid_height) {
+    memset(w, 0, sizeof(*w));
+    w->grid_length = grid_length;
+    w->grid_height = grid_height;
+    w->grid_enc = (bool_cont *) calloc(1, grid_enc_size(grid_length, grid_height));
+    dirty_init(&w->dirty, grid_length, grid_height);
+    w->tallest_wall = WALL_HEIGHT_FULL;
+    w->max_fill_dgps = FPS / 2;
+    w->player.radius = 10;
+    w->player.max_velocity = 300;
+    w->player.movement_accel = 20;
+    w->player.movement_decel = 20;
+    w->player.angle_increment = M_PI / 18;
+    w->player.rotation_speed = 10;
+#if FIXED_MATH
+    w->player.fx_angle_increment = flt_fx(w->player.angle_increment);
+#endif
+}
+
+void free_dgps(struct debug_grid_point* p_i) {
+    while (p_i) {
+        struct debug_grid_point* next = p_i->next;
+        free(p_i);
+        p_i = next;
+    }
+}
+
+void world_free(world* w) {
+    free(w->grid_enc);
+    free(w->wall_layer);
+    dirty_free(&w->dirty);
+    free_dgps(w->fill_dgp_head);
+    free_dgps(w->temp_dgp_head);
+    w->grid_enc = NULL;
+    w->wall_layer = NULL;
+    w->fill_dgp_head = NULL;
+    w->temp_dgp_head = NULL;
+}
+
+/* Grid */
+/* 1 for solid, 0 for open, not bit_bool's mask, so results can be summed and compared */
+int get_grid_bool(world* w, int x, int y) {
+    int i = (w->grid_length * y) + x;
+    return (w->grid_enc[i >> BOOL_CONT_SHIFT] >> (i & (BOOL_CONT_BITS - 1))) & 1;
+}
+
+int get_grid_bool_coords(world* w, int x, int y) {
+    return get_grid_bool(w, x / GRID_SPACING, y / GRID_SPACING);
+}
+
+Uint8 get_wall_info(world* w, int x, int y) {
+    return w->wall_layer ? w->wall_layer[(w->grid_length * y) + x] : 0;
+}
+
+/* In eighths of a full wall */
+int get_wall_height(world* w, int x, int y) {
+    int height = get_wall_info(w, x, y) & 15;
+    return height ? height : WALL_HEIGHT_FULL;
+}
+
+int get_wall_material(world* w, int x, int y) {
+    return get_wall_info(w, x, y) >> 4;
+}
+
+void push_cell_change(world* w, int x, int y) {
+    if (w->num_changed_cells < MAX_CHANGED_CELLS) {
+        w->changed_cells[w->num_changed_cells++] = (grid_cell_change) {x, y, get_grid_bool(w, x, y), get_wall_info(w, x, y)};
+    } else w->changed_cells_overflow = TRUE;
+}
+
+void set_grid_bool(world* w, int x, int y, int val) {
+    int i = (w->grid_length * y) + x;
+    if (!get_grid_bool(w, x, y) == !val) return;
+    bit_assign(&w->grid_enc[i >> BOOL_CONT_SHIFT], i & (BOOL_CONT_BITS - 1), val);
+    dirty_mark(&w->dirty, x, y);
+    push_cell_change(w, x, y);
+}
+
+/* Sets a cell's wall layer byte, making the layer the first time a wall isn't full and plain */
+void set_wall_info(world* w, int x, int y, Uint8 info) {
+    if (get_wall_info(w, x, y) == info) return;
+    if (!w->wall_layer) {
+        w->wall_layer = calloc(w->grid_length * w->grid_height, 1);
+        if (!w->wall_layer) return;
+    }
+    w->wall_layer[(w->grid_length * y) + x] = info;
+    w->tallest_wall = SDL_max(w->tallest_wall, (info & 15) ? info & 15 : WALL_HEIGHT_FULL);
+    dirty_mark(&w->dirty, x, y);
+    push_cell_change(w, x, y);
+}
+
+void clear_changed_cells(world* w) {
+    w->num_changed_cells = 0;
+    w->changed_cells_overflow = FALSE;
+}
+
+/* Replays a change taken from another world's changed cells */
+void world_apply_change(world* w, grid_cell_change* c) {
+    set_grid_bool(w, c->x, c->y, c->val);
+    set_wall_info(w, c->x, c->y, c->wall);
+}
+
+/* Copies the grid and wall layer of a world the same size */
+void world_copy_grid(world* dst, world* src) {
+    memcpy(dst->grid_enc, src->grid_enc, grid_enc_size(src->grid_length, src->grid_height));
+    if (src->wall_layer && !dst->wall_layer) dst->wall_layer = malloc(src->grid_length * src->grid_height);
+    if (src->wall_layer && dst->wall_layer) memcpy(dst->wall_layer, src->wall_layer, src->grid_length * src->grid_height);
+    else if (dst->wall_layer) memset(dst->wall_layer, 0, dst->grid_length * dst->grid_height);
+    dst->tallest_wall = src->tallest_wall;
+}
+
+/* Random Cells */
+#define RANDOM_CELL_TRIES 64 /* Random picks before scanning for an open cell */
+
+/* Steps the linear congruential generator shared by generated maps, benches and --verify, returns its upper 24 bits */
+Uint32 next_random(Uint32* seed) {
+    *seed = (*seed * 1103515245) + 12345;
+    return *seed >> 8;
+}
+
+/*
+ * Picks an open cell at random. On a map too full for random picks to land on one it scans on from
+ * a random cell, so it only returns FALSE when there is no open cell at all.
+ */
+int random_open_cell(world* w, Uint32* seed, xy* cell) {
+    for (int i = 0; i < RANDOM_CELL_TRIES; i++) {
+        int x = next_random(seed) % w->grid_length;
+        int y = next_random(seed) % w->grid_height;
+        if (get_grid_bool(w, x, y)) continue;
+        *cell = (xy) {x, y};
+        return TRUE;
+    }
+    int num_cells = w->grid_length * w->grid_height;
+    int start = next_random(seed) % num_cells;
+    for (int i = 0; i < num_cells; i++) {
+        int c = (start + i) % num_cells;
+        if (get_grid_bool(w, c % w->grid_length, c / w->grid_length)) continue;
+        *cell = (xy) {c % w->grid_length, c / w->grid_length};
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* Map Edits, for doors, destructible walls and anything else changing the grid after setup */
+int in_grid(world* w, int x, int y) {
+    return 0 <= x && x < w->grid_length && 0 <= y && y < w->grid_height;
+}
+
+/* Returns FALSE when the cell is off the map */
+int world_set_cell(world* w, int x, int y, int solid) {
+    if (!in_grid(w, x, y)) return FALSE;
+    set_grid_bool(w, x, y, solid);
+    return TRUE;
+}
+
+int world_toggle_cell(world* w, int x, int y) {
+    if (!in_grid(w, x, y)) return FALSE;
+    set_grid_bool(w, x, y, !get_grid_bool(w, x, y));
+    return TRUE;
+}
+
+/* Sets every cell in the inclusive rectangle, clipped to the map, and returns how many changed */
+int world_fill_cells(world* w, int x0, int y0, int x1, int y1, int solid) {
+    int changed = 0;
+    if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+    if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= w->grid_length) x1 = w->grid_length - 1;
+    if (y1 >= w->grid_height) y1 = w->grid_height - 1;
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            if (!get_grid_bool(w, x, y) != !solid) {
+                set_grid_bool(w, x, y, solid);
+                changed++;
+            }
+        }
+    }
+    return changed;
+}
+
+/*
+ * Makes every cell in the inclusive rectangle, clipped to the map, a wall height eighths tall of the
+ * material, or open when height is 0, and returns how many changed
+ */
+int world_fill_walls(world* w, int x0, int y0, int x1, int y1, int height, int material) {
+    int changed = 0;
+    if (height < 0 || height > WALL_HEIGHT_MAX || material < 0 || material >= WALL_MATERIALS) return -1;
+    if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+    if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= w->grid_length) x1 = w->grid_length - 1;
+    if (y1 >= w->grid_height) y1 = w->grid_height - 1;
+
+    Uint8 info = height ? wall_info(height, material) : 0;
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            if (!get_grid_bool(w, x, y) == !height && get_wall_info(w, x, y) == info) continue;
+            set_grid_bool(w, x, y, height != 0);
+            set_wall_info(w, x, y, info);
+            changed++;
+        }
+    }
+    return changed;
+}
+
+/* Debug Grid Points */
+void new_dgp(int x, int y, rgb color, struct debug_grid_point** head, struct debug_grid_point** tail) {
+    struct debug_grid_point* p = malloc(sizeof(*p));
+    p->x = x;
+    p->y = y;
+    p->color = color;
+    p->next = NULL;
+    if (*head) {
+        (*tail)->next = p;
+        *tail = p;
+    } else {
+        *head = p;
+        *tail = p;
+    }
+}
+
+void add_fill_dgp(world* w, int x, int y, rgb color) {
+    new_dgp(x, y, color, &w->fill_dgp_head, &w->fill_dgp_tail);
+    w->num_fill_dgps++;
+    if (w->num_fill_dgps > w->max_fill_dgps) {
+        struct debug_grid_point* old_head = w->fill_dgp_head;
+        w->fill_dgp_head = w->fill_dgp_head->next;
+        free(old_head);
+    }
+}
+
+void add_temp_dgp(world* w, int x, int y, rgb color) {
+    new_dgp(x, y, color, &w->temp_dgp_head, &w->temp_dgp_tail);
+}
+
+void clear_temp_dgps(world* w) {
+    free_dgps(w->temp_dgp_head);
+    w->temp_dgp_head = NULL;
+    w->temp_dgp_tail = NULL;
+}
+
+/* Raycasting */
+#if FIXED_MATH
+typedef fx_xy (*raycast_kernel)(world* w, fixed x, fixed y, fixed angle);
+#else
+typedef xy (*raycast_kernel)(world* w, int x, int y, float angle);
+#endif
+
+/* Cell index c lies strictly inside (0, len), the same bounds the stepping loops have always used */
+#define IN_GRID_BOUNDS(c, len) ((unsigned) ((c) - 1) < (unsigned) ((len) - 1))
+
+/* Hands a finished ray's counts to this thread's ray_stats, see raystats.h */
+#if RAY_STATS
+#define RAY_STATS_RECORD(SX, SY, H_TESTS, V_TESTS, LOOKUPS, H_LAST, V_LAST, H_WINS, CELL_X, CELL_Y) \
+    if (ray_stats_sink) ray_stats_record(ray_stats_sink, w->grid_length, w->grid_height, SX, SY, H_TESTS, V_TESTS, LOOKUPS, H_LAST, V_LAST, H_WINS, CELL_X, CELL_Y);
+
+/*
+ * Grid reads of a loop that tested TESTS lines: two for each line it passed, then at the line it
+ * stopped on none if that was off the map, one if the first cell was solid and two if only the second
+ */
+#define RAY_STATS_READS(TESTS, IN_BOUNDS, FIRST_X, FIRST_Y) \
+    ((TESTS) > 0 ? (((TESTS) - 1) * 2) + ((IN_BOUNDS) ? 2 - get_grid_bool(w, FIRST_X, FIRST_Y) : 0) : 0)
+#else
+#define RAY_STATS_RECORD(...)
+#endif
+
+#if FIXED_MATH
+/*
+ * Fixed math kernels step like the float ones, but every coordinate carries 16 fractional bits and
+ * sin/cos come from the lookup table, so a ray gives the same hit on every machine. The coordinate
+ * along each crossed line is kept exactly, as its floor plus a remainder over the other axis' step,
+ * so a crossing is only ever on a grid corner when the ray really passes through it.
+ */
+#define FX_CELL_SHIFT (FX_SHIFT + GRID_SHIFT)
+#define FX_GRID_SPACING int_fx(GRID_SPACING)
+
+/* Floor of a / b for b > 0 */
+#define FX_FLOOR_DIV(a, b) ((a) >= 0 ? (a) / (b) : -((-(a) + (b) - 1) / (b)))
+
+/*
+ * Cell index of a crossing along the line it lies on, given its remainder. A ray through a grid
+ * corner crosses the horizontal line first, like reference_raycast, so at a corner the horizontal
+ * loop looks in the column the ray came from and the vertical loop in the row it moves into.
+ * BACK is whether that means the cell before the corner rather than the one after it.
+ */
+#define FX_CROSSING_CELL(c, REM, BACK) (((c) - ((REM) == 0 && (BACK))) >> FX_CELL_SHIFT)
+
+/*
+ * Steps a crossing coordinate C with remainder REM over DEN by the whole part STEP and the
+ * remainder part STEP_REM
+ */
+#define FX_EXACT_STEP(C, REM, DEN, STEP, STEP_REM) { \
+    C += STEP; REM += STEP_REM; \
+    int carry = REM >= DEN; \
+    C += carry; REM -= carry * DEN; \
+}
+
+#define RAYCAST_KERNEL(NAME, SX, SY, TRACE) \
+fx_xy NAME(world* w, fixed x, fixed y, fixed angle) { \
+    fixed sn = fx_sin(angle); \
+    fixed cs = fx_cos(angle); \
+    fixed c_hx = x, c_hy = y, h_rem = 0; \
+    fixed c_vx = x, c_vy = y, v_rem = 0; \
+    int64_t h_dist = INT64_MAX; \
+    int64_t v_dist = INT64_MAX; \
+\
+    if (sn != 0) { \
+        fixed den = sn * SY; \
+        c_hy = (SY > 0 ? (y + FX_GRID_SPACING - 1) >> FX_CELL_SHIFT : y >> FX_CELL_SHIFT) << FX_CELL_SHIFT; \
+        fixed num = (c_hy - y) * cs * SY; \
+        c_hx = x + FX_FLOOR_DIV(num, den); \
+        h_rem = num - (FX_FLOOR_DIV(num, den) * den); \
+        fixed d_hy = SY * FX_GRID_SPACING; \
+        fixed d_num = FX_GRID_SPACING * cs; \
+        fixed d_hx = FX_FLOOR_DIV(d_num, den); \
+        fixed d_rem = d_num - (d_hx * den); \
+        while ( \
+            IN_GRID_BOUNDS(FX_CROSSING_CELL(c_hx, h_rem, SX > 0 && cs != 0), w->grid_length) && IN_GRID_BOUNDS(c_hy >> FX_CELL_SHIFT, w->grid_height) && \
+            !(get_grid_bool(w, FX_CROSSING_CELL(c_hx, h_rem, SX > 0 && cs != 0), (c_hy >> FX_CELL_SHIFT) - 1) || \
+                get_grid_bool(w, FX_CROSSING_CELL(c_hx, h_rem, SX > 0 && cs != 0), c_hy >> FX_CELL_SHIFT)) \
+        ) { \
+            if (TRACE) add_temp_dgp(w, fx_int(c_hx), fx_int(c_hy), C_RED); \
+            c_hy += d_hy; \
+            FX_EXACT_STEP(c_hx, h_rem, den, d_hx, d_rem) \
+        } \
+        h_dist = fx_dist_sq(c_hx - x, c_hy - y); \
+    } \
+\
+    if (cs != 0) { \
+        fixed den = cs * SX; \
+        c_vx = (((x >> FX_CELL_SHIFT) + (SX > 0)) << FX_CELL_SHIFT); \
+        fixed num = (c_vx - x) * sn * SX; \
+        c_vy = y + FX_FLOOR_DIV(num, den); \
+        v_rem = num - (FX_FLOOR_DIV(num, den) * den); \
+        fixed d_vx = SX * FX_GRID_SPACING; \
+        fixed d_num = FX_GRID_SPACING * sn; \
+        fixed d_vy = FX_FLOOR_DIV(d_num, den); \
+        fixed d_rem = d_num - (d_vy * den); \
+        while ( \
+            IN_GRID_BOUNDS(c_vx >> FX_CELL_SHIFT, w->grid_length) && IN_GRID_BOUNDS(FX_CROSSING_CELL(c_vy, v_rem, SY < 0 && sn != 0), w->grid_height) && \
+            !(get_grid_bool(w, (c_vx >> FX_CELL_SHIFT) - 1, FX_CROSSING_CELL(c_vy, v_rem, SY < 0 && sn != 0)) || \
+                get_grid_bool(w, c_vx >> FX_CELL_SHIFT, FX_CROSSING_CELL(c_vy, v_rem, SY < 0 && sn != 0))) \
+        ) { \
+            if (TRACE) add_temp_dgp(w, fx_int(c_vx), fx_int(c_vy), C_RED); \
+            c_vx += d_vx; \
+            FX_EXACT_STEP(c_vy, v_rem, den, d_vy, d_rem) \
+        } \
+        v_dist = fx_dist_sq(c_vx - x, c_vy - y); \
+    } \
+\
+    RAY_STATS_RECORD(SX, SY, \
+        sn != 0 ? ((((c_hy >> FX_CELL_SHIFT) - (SY > 0 ? (y + FX_GRID_SPACING - 1) >> FX_CELL_SHIFT : y >> FX_CELL_SHIFT)) * SY) + 1) : 0, \
+        cs != 0 ? ((((c_vx >> FX_CELL_SHIFT) - ((x >> FX_CELL_SHIFT) + (SX > 0))) * SX) + 1) : 0, \
+        RAY_STATS_READS(sn != 0 ? ((((c_hy >> FX_CELL_SHIFT) - (SY > 0 ? (y + FX_GRID_SPACING - 1) >> FX_CELL_SHIFT : y >> FX_CELL_SHIFT)) * SY) + 1) : 0, \
+            IN_GRID_BOUNDS(FX_CROSSING_CELL(c_hx, h_rem, SX > 0 && cs != 0), w->grid_length) && IN_GRID_BOUNDS(c_hy >> FX_CELL_SHIFT, w->grid_height), \
+            FX_CROSSING_CELL(c_hx, h_rem, SX > 0 && cs != 0), (c_hy >> FX_CELL_SHIFT) - 1) + \
+        RAY_STATS_READS(cs != 0 ? ((((c_vx >> FX_CELL_SHIFT) - ((x >> FX_CELL_SHIFT) + (SX > 0))) * SX) + 1) : 0, \
+            IN_GRID_BOUNDS(c_vx >> FX_CELL_SHIFT, w->grid_length) && IN_GRID_BOUNDS(FX_CROSSING_CELL(c_vy, v_rem, SY < 0 && sn != 0), w->grid_height), \
+            (c_vx >> FX_CELL_SHIFT) - 1, FX_CROSSING_CELL(c_vy, v_rem, SY < 0 && sn != 0)), \
+        c_hy >> FX_CELL_SHIFT, c_vx >> FX_CELL_SHIFT, h_dist < v_dist, \
+        h_dist < v_dist ? FX_CROSSING_CELL(c_hx, h_rem, SX > 0 && cs != 0) : (c_vx >> FX_CELL_SHIFT) - (SX < 0), \
+        h_dist < v_dist ? (c_hy >> FX_CELL_SHIFT) - (SY < 0) : FX_CROSSING_CELL(c_vy, v_rem, SY < 0 && sn != 0)) \
+    if (h_dist < v_dist) return (fx_xy) {c_hx, c_hy}; \
+    else return (fx_xy) {c_vx, c_vy}; \
+}
+
+#else
+/*
+ * One kernel per quadrant: SX and SY are the step signs of the ray, so the first grid lines and the
+ * step deltas are constants. Both cells touching a crossed line are tested, like the original loops.
+ * The coordinate along each crossed line is stepped in double precision, truncated integer steps
+ * drifted up to a pixel per line and let rays slip through corners.
+ * TRACE builds the variant that leaves debug points for show_player_vision.
+ */
+#define RAYCAST_KERNEL(NAME, SX, SY, TRACE) \
+xy NAME(world* w, int x, int y, float angle) { \
+    double t = tan(angle); \
+    int c_hy = (SY > 0 ? (y + GRID_SPACING - 1) >> GRID_SHIFT : y >> GRID_SHIFT) << GRID_SHIFT; \
+    double c_hx = x + ((c_hy - y) / t); \
+    int d_hy = SY * GRID_SPACING; \
+    double d_hx = d_hy / t; \
+    int c_vx = ((x >> GRID_SHIFT) + (SX > 0)) << GRID_SHIFT; \
+    double c_vy = y + (t * (c_vx - x)); \
+    int d_vx = SX * GRID_SPACING; \
+    double d_vy = t * d_vx; \
+\
+    while ( \
+        IN_GRID_BOUNDS((int) c_hx >> GRID_SHIFT, w->grid_length) && IN_GRID_BOUNDS(c_hy >> GRID_SHIFT, w->grid_height) && \
+        !(get_grid_bool(w, (int) c_hx >> GRID_SHIFT, (c_hy >> GRID_SHIFT) - 1) || get_grid_bool(w, (int) c_hx >> GRID_SHIFT, c_hy >> GRID_SHIFT)) \
+    ) { \
+        if (TRACE) add_temp_dgp(w, c_hx, c_hy, C_RED); \
+        c_hx += d_hx; c_hy += d_hy; \
+    } \
+\
+    while ( \
+        IN_GRID_BOUNDS(c_vx >> GRID_SHIFT, w->grid_length) && IN_GRID_BOUNDS((int) c_vy >> GRID_SHIFT, w->grid_height) && \
+        !(get_grid_bool(w, (c_vx >> GRID_SHIFT) - 1, (int) c_vy >> GRID_SHIFT) || get_grid_bool(w, c_vx >> GRID_SHIFT, (int) c_vy >> GRID_SHIFT)) \
+    ) { \
+        if (TRACE) add_temp_dgp(w, c_vx, c_vy, C_RED); \
+        c_vx += d_vx; c_vy += d_vy; \
+    } \
+\
+    double h_dist = ((c_hx - x) * (c_hx - x)) + ((double) (c_hy - y) * (c_hy - y)); \
+    double v_dist = ((double) (c_vx - x) * (c_vx - x)) + ((c_vy - y) * (c_vy - y)); \
+    RAY_STATS_RECORD(SX, SY, \
+        (((c_hy >> GRID_SHIFT) - (SY > 0 ? (y + GRID_SPACING - 1) >> GRID_SHIFT : y >> GRID_SHIFT)) * SY) + 1, \
+        (((c_vx >> GRID_SHIFT) - ((x >> GRID_SHIFT) + (SX > 0))) * SX) + 1, \
+        RAY_STATS_READS((((c_hy >> GRID_SHIFT) - (SY > 0 ? (y + GRID_SPACING - 1) >> GRID_SHIFT : y >> GRID_SHIFT)) * SY) + 1, \
+            IN_GRID_BOUNDS((int) c_hx >> GRID_SHIFT, w->grid_length) && IN_GRID_BOUNDS(c_hy >> GRID_SHIFT, w->grid_height), \
+            (int) c_hx >> GRID_SHIFT, (c_hy >> GRID_SHIFT) - 1) + \
+        RAY_STATS_READS((((c_vx >> GRID_SHIFT) - ((x >> GRID_SHIFT) + (SX > 0))) * SX) + 1, \
+            IN_GRID_BOUNDS(c_vx >> GRID_SHIFT, w->grid_length) && IN_GRID_BOUNDS((int) c_vy >> GRID_SHIFT, w->grid_height), \
+            (c_vx >> GRID_SHIFT) - 1, (int) c_vy >> GRID_SHIFT), \
+        c_hy >> GRID_SHIFT, c_vx >> GRID_SHIFT, h_dist < v_dist, \
+        h_dist < v_dist ? (int) c_hx >> GRID_SHIFT : (c_vx >> GRID_SHIFT) - (SX < 0), \
+        h_dist < v_dist ? (c_hy >> GRID_SHIFT) - (SY < 0) : (int) c_vy >> GRID_SHIFT) \
+    if (h_dist < v_dist) return (xy) {c_hx, c_hy}; \
+    else return (xy) {c_vx, c_vy}; \
+}
+#endif
+
+RAYCAST_KERNEL(raycast_q0, 1, 1, FALSE)
+RAYCAST_KERNEL(raycast_q1, -1, 1, FALSE)
+RAYCAST_KERNEL(raycast_q2, -1, -1, FALSE)
+RAYCAST_KERNEL(raycast_q3, 1, -1, FALSE)
+RAYCAST_KERNEL(raycast_q0_trace, 1, 1, TRUE)
+RAYCAST_KERNEL(raycast_q1_trace, -1, 1, TRUE)
+RAYCAST_KERNEL(raycast_q2_trace, -1, -1, TRUE)
+RAYCAST_KERNEL(raycast_q3_trace, 1, -1, TRUE)
+
+raycast_kernel raycast_kernels[2][4] = {
+    {raycast_q0, raycast_q1, raycast_q2, raycast_q3},
+    {raycast_q0_trace, raycast_q1_trace, raycast_q2_trace, raycast_q3_trace}
+};
+
+#if FIXED_MATH
+/* The quadrant comes from the same table index the kernel's sin/cos use, so their signs always agree */
+raycast_kernel pick_raycast_kernel(fixed angle, int trace) {
+    return raycast_kernels[trace != 0][fx_trig_index(angle) >> (TRIG_LUT_BITS - 2)];
+}
+
+fx_xy raycast(world* w, fixed x, fixed y, fixed angle, int trace) {
+    return pick_raycast_kernel(angle, trace)(w, x, y, angle);
+}
+#else
+/* Angle must already be wrapped into [0, 2pi) */
+raycast_kernel pick_raycast_kernel(float angle, int trace) {
+    return raycast_kernels[trace != 0][(int) (angle / (M_PI / 2)) & 3];
+}
+
+xy raycast(world* w, int x, int y, float angle, int trace) {
+    return pick_raycast_kernel(angle, trace)(w, x, y, angle);
+}
+#endif
+
+/* Player Control */
+void assign_i_player_pos(player* p) {
+    p->i_x = round(p->x);
+    p->i_y = round(p->y);
+}
+
+void reset_player(player* p) {
+    p->x = GRID_SPACING * 4;
+    p->y = GRID_SPACING * 4;
+    assign_i_player_pos(p);
+    p->x_velocity = 0;
+    p->y_velocity = 0;
+    p->angle = 0;
+}
+
+void rotate_player(player* p, float angle) {
+    p->angle += angle;
+    while (p->angle < 0) p->angle += M_PI * 2;
+    while (p->angle >= M_PI * 2) p->angle -= (M_PI * 2);
+}
+
+void push_player_forward(player* p, int force) {
+    p->x_velocity += cos(p->angle) * force;
+    p->y_velocity += sin(p->angle) * force;
+}
+
+void push_player_right(player* p, int force) {
+    p->angle += M_PI / 2;
+    push_player_forward(p, force);
+    p->angle -= M_PI / 2;
+}
+
+#if FIXED_MATH
+void rotate_player_fx(player* p, fixed angle) {
+    p->fx_angle = fx_wrap_angle(p->fx_angle + angle);
+}
+
+void push_player_forward_fx(player* p, int force) {
+    p->fx_x_velocity += fx_cos(p->fx_angle) * force;
+    p->fx_y_velocity += fx_sin(p->fx_angle) * force;
+}
+
+void push_player_right_fx(player* p, int force) {
+    p->fx_x_velocity += fx_cos(p->fx_angle + FX_HALF_PI) * force;
+    p->fx_y_velocity += fx_sin(p->fx_angle + FX_HALF_PI) * force;
+}
+
+/* Float mirrors only differ from the fixed state when something else (resets, debug menu) wrote them */
+void sync_fx_player(player* p) {
+    if (p->x != fx_flt(p->fx_x)) p->fx_x = flt_fx(p->x);
+    if (p->y != fx_flt(p->fx_y)) p->fx_y = flt_fx(p->y);
+    if (p->x_velocity != fx_flt(p->fx_x_velocity)) p->fx_x_velocity = flt_fx(p->x_velocity);
+    if (p->y_velocity != fx_flt(p->fx_y_velocity)) p->fx_y_velocity = flt_fx(p->y_velocity);
+    if (p->angle != fx_flt(p->fx_angle)) p->fx_angle = fx_wrap_angle(flt_fx(p->angle));
+}
+
+void publish_fx_player(player* p) {
+    p->x = fx_flt(p->fx_x);
+    p->y = fx_flt(p->fx_y);
+    p->x_velocity = fx_flt(p->fx_x_velocity);
+    p->y_velocity = fx_flt(p->fx_y_velocity);
+    p->angle = fx_flt(p->fx_angle);
+}
+#endif